@@ -1,12 +1,13 @@
 #pragma once
 
 #include <memory>
-#include <opencv2\opencv.hpp>
+#include <string>
+#include <opencv2/opencv.hpp>
+#include "Context.h"
 #include "Option.h"
 
 namespace mobamas {
 
-struct Context;
 struct DepthMap;
 
 // Pinch detection algorithms return a most confident pinch point, if any.
@@ -14,5 +15,59 @@ struct DepthMap;
 // The z is actual depth value in mm.
 Option<cv::Point3f> PinchRightEdge(std::shared_ptr<Context> context, const DepthMap& data);
 Option<cv::Point3f> PinchCenterOfHole(std::shared_ptr<Context> context, const DepthMap& data);
+// With the minimum area of the pinch hole in px, to tune by PinchBench --sweep.
+Option<cv::Point3f> PinchRightEdge(std::shared_ptr<Context> context, const DepthMap& data, double min_hole_size);
+Option<cv::Point3f> PinchCenterOfHole(std::shared_ptr<Context> context, const DepthMap& data, double min_hole_size);
+// Thinnest part of the hand ring around the pinch hole, found by distance transforms
+// in linear time instead of contour hierarchies.
+Option<cv::Point3f> PinchDistanceTransform(std::shared_ptr<Context> context, const DepthMap& data);
+// Coarse-to-fine PinchRightEdge for large masks such as the doubled frontal image.
+// The hole is found on the mask downsampled by factor, and the pinch point is refined
+// at full resolution only around the coarse candidate.
+Option<cv::Point3f> PinchRightEdgePyramid(std::shared_ptr<Context> context, const DepthMap& data, int factor);
+template <int Factor>
+Option<cv::Point3f> PinchRightEdgePyramid(std::shared_ptr<Context> context, const DepthMap& data) {
+	return PinchRightEdgePyramid(context, data, Factor);
+}
+// The hole found in the last frame by PinchRightEdgeTracking.
+struct HoleTrack {
+	bool tracking = false;
+	cv::Point seed; // background pixel inside the hole
+	double area;
+	int perimeter;
+	int right_x;
+};
+// PinchRightEdge which keeps the hole between frames, and only traces its boundary and
+// the right edge near the last position. Falls back to full detection when lost.
+// Keeps its state in context->hole_track, so call it from one thread on consecutive
+// frames, and give each stream of frames a new HoleTrack.
+Option<cv::Point3f> PinchRightEdgeTracking(std::shared_ptr<Context> context, const DepthMap& data);
+// Centroid of the pixels classified as pinch contact by a decision forest (PinchForest.h),
+// so that it works while the pinch hole is occluded. Classification is cut off at a fixed
+// budget per frame. The forest is context->pinch_forest, loaded beforehand by
+// LoadPinchDetectionForest; nothing is found without it.
+Option<cv::Point3f> PinchDecisionForest(std::shared_ptr<Context> context, const DepthMap& data);
+// Null if the forest cannot be read.
+std::shared_ptr<const PinchForest> LoadPinchDetectionForest(std::string const& path = "pinch_forest.yml.gz");
+
+typedef Option<cv::Point3f> (*PinchAlgorithm)(std::shared_ptr<Context> context, const DepthMap& data);
+inline PinchAlgorithm SelectPinchAlgorithm(PinchDetector detector) {
+	switch (detector) {
+	case CenterOfHoleDetector:
+		return PinchCenterOfHole;
+	case DistanceTransformDetector:
+		return PinchDistanceTransform;
+	case PyramidX2Detector:
+		return PinchRightEdgePyramid<2>;
+	case PyramidX4Detector:
+		return PinchRightEdgePyramid<4>;
+	case TrackingDetector:
+		return PinchRightEdgeTracking;
+	case DecisionForestDetector:
+		return PinchDecisionForest;
+	default:
+		return PinchRightEdge;
+	}
+}
 
 }
\ No newline at end of file
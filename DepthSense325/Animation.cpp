@@ -0,0 +1,98 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mobamas {
+
+// a + (b - a) * t of quaternions, on the shorter arc and normalized
+static inline void Nlerp(float const* a, float const* b, float t, float* out) {
+	float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+	float tb = dot < 0 ? -t : t;
+	float norm = 0;
+	for (int i = 0; i < 4; i++) {
+		out[i] = a[i] * (1 - t) + b[i] * tb;
+		norm += out[i] * out[i];
+	}
+	norm = norm > 0 ? 1 / std::sqrt(norm) : 1;
+	for (int i = 0; i < 4; i++)
+		out[i] *= norm;
+}
+
+static inline void Lerp3(float const* a, float const* b, float t, float* out) {
+	for (int i = 0; i < 3; i++)
+		out[i] = a[i] + (b[i] - a[i]) * t;
+}
+
+// Keys around time and the fraction between them.
+static inline void FindKeys(std::vector<float> const& times, float time, int& k0, int& k1, float& t) {
+	int n = static_cast<int>(times.size());
+	k1 = static_cast<int>(std::upper_bound(times.begin(), times.end(), time) - times.begin());
+	if (k1 == 0) {
+		k0 = k1 = 0;
+		t = 0;
+	} else if (k1 == n) {
+		k0 = k1 = n - 1;
+		t = 0;
+	} else {
+		k0 = k1 - 1;
+		float span = times[k1] - times[k0];
+		t = span > 0 ? (time - times[k0]) / span : 0;
+	}
+}
+
+static void SampleTrack(BoneTrack const& track, float time, BonePose& pose) {
+	int k0, k1;
+	float t;
+	FindKeys(track.rotation_times, time, k0, k1, t);
+	Nlerp(&track.rotations[k0 * 4], &track.rotations[k1 * 4], t, pose.rotation);
+	FindKeys(track.position_times, time, k0, k1, t);
+	Lerp3(&track.positions[k0 * 3], &track.positions[k1 * 3], t, pose.position);
+}
+
+void ResampleAnimation(SkeletalAnimation& animation, float frame_rate) {
+	int tracks = static_cast<int>(animation.tracks.size());
+	animation.frame_rate = frame_rate;
+	animation.frames = static_cast<int>(std::ceil(animation.duration * frame_rate)) + 1;
+	animation.frame_rotations.resize(animation.frames * tracks * 4);
+	animation.frame_positions.resize(animation.frames * tracks * 3);
+	BonePose pose;
+	for (int f = 0; f < animation.frames; f++) {
+		float time = std::min(animation.duration, f / frame_rate);
+		for (int i = 0; i < tracks; i++) {
+			SampleTrack(animation.tracks[i], time, pose);
+			std::copy(pose.rotation, pose.rotation + 4, &animation.frame_rotations[(f * tracks + i) * 4]);
+			std::copy(pose.position, pose.position + 3, &animation.frame_positions[(f * tracks + i) * 3]);
+		}
+	}
+}
+
+void SampleAnimation(SkeletalAnimation const& animation, float time, std::vector<BonePose>& poses) {
+	int tracks = static_cast<int>(animation.tracks.size());
+	poses.resize(tracks);
+	if (animation.duration > 0) {
+		time = std::fmod(time, animation.duration);
+		if (time < 0)
+			time += animation.duration;
+	} else {
+		time = 0;
+	}
+	if (animation.frames == 0) {
+		for (int i = 0; i < tracks; i++)
+			SampleTrack(animation.tracks[i], time, poses[i]);
+		return;
+	}
+	// one pass over two contiguous frames
+	float frame = time * animation.frame_rate;
+	int f0 = std::min(static_cast<int>(frame), animation.frames - 1);
+	int f1 = std::min(f0 + 1, animation.frames - 1);
+	float t = frame - f0;
+	auto r0 = &animation.frame_rotations[f0 * tracks * 4], r1 = &animation.frame_rotations[f1 * tracks * 4];
+	auto p0 = &animation.frame_positions[f0 * tracks * 3], p1 = &animation.frame_positions[f1 * tracks * 3];
+	for (int i = 0; i < tracks; i++) {
+		Nlerp(r0 + i * 4, r1 + i * 4, t, poses[i].rotation);
+		Lerp3(p0 + i * 3, p1 + i * 3, t, poses[i].position);
+	}
+}
+
+}
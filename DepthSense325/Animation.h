@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace mobamas {
+
+// Keyframe animations of a skeleton, imported from the aiAnimations of a model.
+
+// Keys of one bone with times in sec, sorted ascending. Each track has at least
+// one key of each kind; the importer fills missing ones with the rest transform.
+struct BoneTrack {
+	int bone; // index in the skeleton
+	std::vector<float> rotation_times;
+	std::vector<float> rotations; // w, x, y, z per key
+	std::vector<float> position_times;
+	std::vector<float> positions; // x, y, z per key
+};
+
+struct SkeletalAnimation {
+	std::string name;
+	float duration; // sec
+	std::vector<BoneTrack> tracks;
+	// Optional uniform resampling of every track, frame major so that a pose of
+	// all bones is contiguous and found without searching the keys.
+	float frame_rate = 0; // frames per sec, 0 unless resampled
+	int frames = 0;
+	std::vector<float> frame_rotations; // frames * tracks * 4
+	std::vector<float> frame_positions; // frames * tracks * 3
+};
+
+struct BonePose {
+	float rotation[4]; // w, x, y, z
+	float position[3];
+};
+
+// Resamples all tracks at frame_rate for SampleAnimation; 60 keeps the error
+// of the linear interpolation between frames under what the display shows.
+void ResampleAnimation(SkeletalAnimation& animation, float frame_rate);
+
+// Pose of every track at time, wrapped by the duration; poses[i] for tracks[i].
+// Rotations are interpolated by normalized lerp along the shorter arc.
+void SampleAnimation(SkeletalAnimation const& animation, float time, std::vector<BonePose>& poses);
+
+}
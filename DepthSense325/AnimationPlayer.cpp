@@ -0,0 +1,29 @@
+#include "AnimationPlayer.h"
+
+#include "Import.h"
+
+namespace mobamas {
+
+AnimationPlayer::AnimationPlayer(MeshGroup* group, size_t animation) :
+	group_(group),
+	animation_(animation) {
+}
+
+void AnimationPlayer::Update(double time) {
+	auto skeleton = group_->getSkeleton();
+	if (!skeleton)
+		return;
+	auto const& animation = group_->getAnimations()[animation_];
+	SampleAnimation(animation, static_cast<float>(time), poses_);
+	for (size_t i = 0; i < poses_.size(); i++) {
+		auto const& pose = poses_[i];
+		int id = animation.tracks[i].bone;
+		auto bone = skeleton->getBone(id);
+		bone->setPosition(pose.position[0], pose.position[1], pose.position[2]);
+		bone->setRotationQuat(pose.rotation[0], pose.rotation[1], pose.rotation[2], pose.rotation[3]);
+		group_->markBoneDirty(id);
+	}
+	group_->applyBoneMotion(SkinDirtyBones);
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+#include "Animation.h"
+
+namespace mobamas {
+
+class MeshGroup;
+
+// Plays a SkeletalAnimation of a MeshGroup: poses the animated bones and skins
+// only the vertices they move. Start with "--animate".
+class AnimationPlayer {
+public:
+	// animation is the index in getAnimations(), which may grow while playing.
+	AnimationPlayer(MeshGroup* group, size_t animation);
+	// Pose for time in sec since the start of the playback.
+	void Update(double time);
+
+private:
+	MeshGroup* group_;
+	size_t animation_;
+	std::vector<BonePose> poses_;
+};
+
+}
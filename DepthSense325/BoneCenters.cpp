@@ -0,0 +1,89 @@
+#include "BoneCenters.h"
+
+#include "Import.h"
+#include "Skinning.h"
+
+namespace mobamas {
+
+BoneCenters::BoneCenters(MeshGroup* group) : group_(group) {
+	weights_.assign(group->getSkeleton()->getNumBones(), 0);
+	for (auto mesh : group->getSceneMeshes()) {
+		for (auto const& bucket : group->skinning(mesh).buckets) {
+			for (int i = 0, n = bucket.count * bucket.influences; i < n; i++)
+				weights_[bucket.bones[i]] += bucket.weights[i] * (1.0 / kWeightScale);
+		}
+	}
+}
+
+void BoneCenters::Track(std::vector<unsigned int> const& bones) {
+	size_t n_bones = weights_.size();
+	// index in bones of each tracked bone, or -1
+	std::vector<int> tracked(n_bones, -1);
+	for (size_t t = 0; t < bones.size(); t++)
+		tracked[bones[t]] = t;
+	tracked_.clear();
+	for (auto mesh : group_->getSceneMeshes()) {
+		// dense moments of the tracked bones against every bone
+		std::vector<double> dense(bones.size() * n_bones * 4, 0);
+		for (auto const& bucket : group_->skinning(mesh).buckets) {
+			int k_max = bucket.influences;
+			for (int slot = 0; slot < bucket.count; slot++) {
+				auto bone_ids = &bucket.bones[slot * k_max];
+				auto weights = &bucket.weights[slot * k_max];
+				for (int k = 0; k < k_max; k++) {
+					int t = tracked[bone_ids[k]];
+					if (t < 0 || weights[k] == 0)
+						continue;
+					for (int j = 0; j < k_max; j++) {
+						double w = weights[k] * (1.0 / kWeightScale) * weights[j] * (1.0 / kWeightScale);
+						auto m = &dense[(t * n_bones + bone_ids[j]) * 4];
+						m[0] += w * bucket.px[slot];
+						m[1] += w * bucket.py[slot];
+						m[2] += w * bucket.pz[slot];
+						m[3] += w;
+					}
+				}
+			}
+		}
+		for (size_t t = 0; t < bones.size(); t++) {
+			MeshMoments entry;
+			entry.mesh = mesh;
+			for (size_t j = 0; j < n_bones; j++) {
+				auto m = &dense[(t * n_bones + j) * 4];
+				if (m[3] == 0)
+					continue;
+				Moment moment = { static_cast<unsigned int>(j), { m[0], m[1], m[2], m[3] } };
+				entry.moments.push_back(moment);
+			}
+			if (!entry.moments.empty())
+				tracked_[bones[t]].push_back(entry);
+		}
+	}
+}
+
+Polycode::Vector3 BoneCenters::Center(unsigned int bone) const {
+	auto found = tracked_.find(bone);
+	if (found == tracked_.end())
+		return Polycode::Vector3(0, 0, 0);
+	auto const& palette = group_->palette();
+	Polycode::Vector3 sum(0, 0, 0);
+	double total = 0;
+	for (auto const& entry : found->second) {
+		double local[3] = {}, weight = 0;
+		for (auto const& moment : entry.moments) {
+			auto row = &palette[moment.bone * kPaletteStride];
+			for (int r = 0; r < 3; r++) {
+				local[r] += row[r * 4] * moment.m[0] + row[r * 4 + 1] * moment.m[1]
+					+ row[r * 4 + 2] * moment.m[2] + row[r * 4 + 3] * moment.m[3];
+			}
+			weight += moment.m[3];
+		}
+		// the transform is affine, so the center moves with it
+		Polycode::Vector3 center(local[0] / weight, local[1] / weight, local[2] / weight);
+		sum += entry.mesh->getConcatenatedMatrix() * center * weight;
+		total += weight;
+	}
+	return sum / total;
+}
+
+}
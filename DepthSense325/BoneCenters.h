@@ -0,0 +1,44 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <Polycode.h>
+
+namespace mobamas {
+
+class MeshGroup;
+
+// Weighted centers of bones over the skinned vertices they weight, for the handle
+// markers of BoneManipulation. Skinned positions are linear in the bone matrices,
+// so the weighted sum of a bone is the sum over the bones j sharing its vertices
+// of matrix j times the moment sum(w_bone * w_j * (x, y, z, 1)) of the rest pose.
+// The moments are precomputed for the tracked bones, so a center costs
+// O(bones sharing vertices) instead of a pass over all vertices.
+class BoneCenters {
+public:
+	BoneCenters() {}
+	// Sums up the weights of every bone of the group.
+	explicit BoneCenters(MeshGroup* group);
+	// Total weight of a bone over all vertices, 0 if it moves no vertex.
+	double weight(unsigned int bone) const { return bone < weights_.size() ? weights_[bone] : 0; }
+	// Precompute the moments of bones; call once with all bones to be passed to Center.
+	void Track(std::vector<unsigned int> const& bones);
+	// Center in world space in the pose of the last MeshGroup::applyBoneMotion,
+	// (0, 0, 0) for bones without vertices.
+	Polycode::Vector3 Center(unsigned int bone) const;
+
+private:
+	struct Moment {
+		unsigned int bone;
+		double m[4];
+	};
+	struct MeshMoments {
+		Polycode::SceneMesh* mesh;
+		std::vector<Moment> moments;
+	};
+	MeshGroup* group_ = nullptr;
+	std::vector<double> weights_;
+	std::map<unsigned int, std::vector<MeshMoments>> tracked_;
+};
+
+}
@@ -75,8 +75,6 @@ const std::map<Models, std::vector<std::wstring>> kManipulatableBones = ([] {
 	return map;
 })();
 
-static std::vector<Polycode::Vector3> CalculateBoneCenters(MeshGroup* group);
-
 Polycode::ScenePrimitive* CreateHandleMarker() {
 	auto marker = new Polycode::ScenePrimitive(Polycode::ScenePrimitive::TYPE_VPLANE, 0.2, 0.2);
 	marker->setColor(0.8, 0.5, 0.5, 0.8);
@@ -92,7 +90,9 @@ BoneManipulation::BoneManipulation(std::shared_ptr<Context> context, Polycode::S
 	scene_(scene),
 	mesh_(mesh),
 	handles_(),
-	current_target_(nullptr)
+	current_target_(nullptr),
+	mouse_filter_(CreatePinchFilter(PinchFilterParamsFor(OperationMode::MouseMode))),
+	timings_()
 {
 	auto skeleton = mesh->getSkeleton();
 	if (!skeleton)
@@ -104,24 +104,30 @@ BoneManipulation::BoneManipulation(std::shared_ptr<Context> context, Polycode::S
 		bone_id_map[b] = bidx;
 		b->disableAnimation = true;
 	}
-	auto centers = CalculateBoneCenters(mesh);
+	centers_ = BoneCenters(mesh);
+	std::vector<unsigned int> tracked;
 	for (auto name: kManipulatableBones.at(model)) {
 		BoneHandle handle;
 		auto bone = handle.bone = skeleton->getBoneByName(name);
 		assert(bone);
+		handle.bone_id = bone_id_map[bone];
 		handle.marker = CreateHandleMarker();
 		auto child = bone;
 		while (child->getNumChildBones() > 0) {
 			child = child->getChildBone(0);
 		}
 		// Get back, because some bones have no associated vertices.
-		while (centers[bone_id_map[child]] == Polycode::Vector3(0, 0, 0)) {
+		while (centers_.weight(bone_id_map[child]) == 0) {
 			child = child->getParentBone();
 		}
 		handle.handle_bone_id = bone_id_map[child];
 		handles_.push_back(handle);
 		scene->addEntity(handle.marker);
+		tracked.push_back(handle.handle_bone_id);
+		if (bone->parentBoneId >= 0)
+			tracked.push_back(bone->parentBoneId);
 	}
+	centers_.Track(tracked);
 
 	auto input = Polycode::CoreServices::getInstance()->getInput();
 	using Polycode::InputEvent;
@@ -156,22 +162,35 @@ static bool IsClick(MouseTiming const& down, MouseTiming const& up) {
 	return up.timestamp - down.timestamp < 200 && up.position.distance(down.position) < 3;
 }
 
+static cv::Point3f FakePinchPoint(Polycode::InputEvent* e) {
+	auto point = e->getMousePosition();
+	return cv::Point3f(point.x / static_cast<float>(kWinWidth),
+		point.y / static_cast<float>(kWinHeight),
+		100);
+}
+
+void BoneManipulation::StartMousePinch(Polycode::InputEvent* e) {
+	auto point = FakePinchPoint(e);
+	mouse_filter_->Reset(point, e->timestamp / 1000.0);
+	mouse_pinching_ = true;
+	OnPinchStart(point);
+}
+
 void BoneManipulation::handleEvent(Polycode::Event *e) {
 	using Polycode::InputEvent;
 
-	auto fake_3d_coord = [](InputEvent* e) {
-		auto point = e->getMousePosition();
-		return cv::Point3f(point.x / static_cast<float>(kWinWidth),
-			point.y / static_cast<float>(kWinHeight),
-			100);
-	};
-
 	switch (e->getEventCode()) {
 	case InputEvent::EVENT_MOUSEMOVE:
 	{
 		auto ie = (InputEvent*)e;
 		if (capture_mouse_event_ || picker_->pen_target() == PenTarget::BONE) {
-			OnPinchMove(fake_3d_coord(ie));
+			auto point = FakePinchPoint(ie);
+			if (mouse_pinching_) {
+				double timestamp = ie->timestamp / 1000.0;
+				mouse_filter_->Update(point, timestamp);
+				point = mouse_filter_->Predict(timestamp);
+			}
+			OnPinchMove(point);
 			e->cancelEvent();
 		}
 		break;
@@ -182,7 +201,7 @@ void BoneManipulation::handleEvent(Polycode::Event *e) {
 
 		if ((ie->getMouseButton() == kMouseButtonCode && capture_mouse_event_) ||
 			(context_->operation_mode == OperationMode::TouchMode && picker_->pen_target() == PenTarget::BONE)) {
-			OnPinchStart(fake_3d_coord(ie));
+			StartMousePinch(ie);
 			e->cancelEvent();
 		}
 		down_timing_ = TimingFromEvent(ie);
@@ -193,14 +212,16 @@ void BoneManipulation::handleEvent(Polycode::Event *e) {
 		auto ie = (InputEvent*)e;
 		if (ie->getMouseButton() == kMouseButtonCode) {
 			if (IsClick(down_timing_, TimingFromEvent(ie))) {
-				if (current_target_.load()) {
+				if (current_target_) {
+					mouse_pinching_ = false;
 					OnPinchEnd();
 				}
 				else {
-					OnPinchStart(fake_3d_coord(ie));
+					StartMousePinch(ie);
 				}
 			}
-			else if (current_target_.load()) {
+			else if (current_target_) {
+				mouse_pinching_ = false;
 				OnPinchEnd();
 			}
 		}
@@ -212,7 +233,7 @@ void BoneManipulation::handleEvent(Polycode::Event *e) {
 		auto key = ie->getKey();
 		if (key == KEY_LCTRL || key == KEY_RCTRL)
 			capture_mouse_event_ = true;
-		if (current_target_.load()) {
+		if (current_target_) {
 			Polycode::Quaternion q;
 			if (key == KEY_UP || key == KEY_RIGHT) {
 				q.createFromAxisAngle(0, 0, 1, 2.5);
@@ -236,35 +257,8 @@ void BoneManipulation::handleEvent(Polycode::Event *e) {
 	}
 }
 
-// TODO: optimize this and ActualVertexPositions
-// calculate only for required bone ids
-static std::vector<Polycode::Vector3> CalculateBoneCenters(MeshGroup* group) {
-	auto skeleton = group->getSkeleton();
-	std::vector<Polycode::Vector3> bone_centers(skeleton->getNumBones(), Polycode::Vector3(0, 0, 0));
-	std::vector<double> bone_weights(skeleton->getNumBones(), 0);
-	for (auto mesh : group->getSceneMeshes()) {
-		auto raw = mesh->getMesh();
-		std::vector<Polycode::Vector3> adjusted_points = ActualVertexPositions(mesh);
-		auto indices = raw->vertexBoneIndexArray;
-		auto weights = raw->vertexBoneWeightArray;
-		for (int vi = 0; vi < indices.getDataSize(); vi++) {
-			int bi = indices.data[vi];
-			double w = weights.data[vi];
-			if (w > 0.0) {
-				bone_centers[bi] += adjusted_points[vi / 4] * w;
-				bone_weights[bi] += w;
-			}
-		}
-	}
-	for (int i = 0; i < bone_centers.size(); i++) {
-		if (bone_weights[i] > 0.0)
-			bone_centers[i] = bone_centers[i] / bone_weights[i];
-	}
-	return bone_centers;
-}
-
 // 󔠂𐳖ʂJƂ̋C}C`
-static Polycode::Vector2 EstimateXyRotationCenter(Polycode::Scene* scene, std::vector<Polycode::Vector3> const& centers, BoneHandle const* current_target, Polycode::Vector2 pinch_offset) {
+static Polycode::Vector2 EstimateXyRotationCenter(Polycode::Scene* scene, BoneCenters const& centers, BoneHandle const* current_target, Polycode::Vector2 pinch_offset) {
 	assert(current_target->bone->parentBoneId >= 0);
 
 	// Prepare rendering environment
@@ -276,8 +270,8 @@ static Polycode::Vector2 EstimateXyRotationCenter(Polycode::Scene* scene, std::v
 	auto camera = renderer->getCameraMatrix();
 	auto projection = renderer->getProjectionMatrix();
 	auto view = renderer->getViewport();
-	auto this_pos = renderer->Project(camera, projection, view, centers[current_target->handle_bone_id]);
-	auto parent_pos = renderer->Project(camera, projection, view, centers[current_target->bone->parentBoneId]);
+	auto this_pos = renderer->Project(camera, projection, view, centers.Center(current_target->handle_bone_id));
+	auto parent_pos = renderer->Project(camera, projection, view, centers.Center(current_target->bone->parentBoneId));
 
 	renderer->EndRender();
 
@@ -287,30 +281,29 @@ static Polycode::Vector2 EstimateXyRotationCenter(Polycode::Scene* scene, std::v
 void BoneManipulation::Update() {
 	if (mesh_->getSkeleton() == nullptr)
 		return;
-	auto bone_centers = CalculateBoneCenters(mesh_);
+	int64 start = cv::getTickCount();
 	for (auto handle: handles_) {
-		handle.marker->setPosition(bone_centers[handle.handle_bone_id]);
+		handle.marker->setPosition(centers_.Center(handle.handle_bone_id));
 	}
-	auto target = current_target_.load();
+	auto target = current_target_;
 	if (require_xy_rotation_center_recalculation_ && target) {
 		target->marker->setColor(1.0, 0.5, 0.5, 0.8);
-		xy_rotation_center_ = EstimateXyRotationCenter(scene_, CalculateBoneCenters(mesh_), target, pinch_offset);
+		xy_rotation_center_ = EstimateXyRotationCenter(scene_, centers_, target, pinch_offset);
 		require_xy_rotation_center_recalculation_ = false;
 	}
+	timings_.handles += cv::getTickCount() - start;
 }
 
 static Polycode::Vector2 PinchPointOnWindow(cv::Point3f const& point) {
 	return CameraPointToScreen(point.x, point.y);
 }
 void BoneManipulation::OnPinchStart(cv::Point3f point) {
+	if (journal_)
+		journal_->Write(PinchStartEvent, point);
 	pinch_prev_ = point;
-	cached_points_.clear();
-	for (int i = 0; i < 6; i++) {
-		cached_points_.push_back(point);
-	}
 
 	auto new_target = SelectHandleByWindowCoord(PinchPointOnWindow(point), 10.0);
-	current_target_.store(new_target);
+	current_target_ = new_target;
 	require_xy_rotation_center_recalculation_ = true; // flag for calculating after that
 	if (new_target) {
 		context_->writer->log() << "PinchStart " << point.x << ", " << point.y << ", " << point.z << ": " << new_target->handle_bone_id << std::endl;
@@ -340,25 +333,17 @@ static Polycode::Quaternion FromTwoVectors(Polycode::Vector3 const& u, Polycode:
 }
 
 void BoneManipulation::OnPinchMove(cv::Point3f point) {
+	if (journal_)
+		journal_->Write(PinchMoveEvent, point);
 #ifdef _DEBUG
 	DisplayDebugPoint(point);
 #endif
 
-	auto target = current_target_.load();
+	auto target = current_target_;
 	if (target == nullptr)
 		return;
-	cached_points_.push_back(point);
-	if ((int)cached_points_.size() < 6) {
-		std::cout << "ret" << std::endl;
-		return;
-	}
-	cached_points_.pop_front();
-
-	cv::Point3f point_new;
-	for (const auto point : cached_points_) {
-		point_new += point;
-	}
-	point_new *= (1 / 6.0f);
+	// already smoothed by PinchFilter, in PinchTracker or handleEvent
+	auto point_new = point;
 	auto from_xy = PinchPointOnWindow(pinch_prev_) - xy_rotation_center_;
 	auto to_xy = PinchPointOnWindow(point_new) - xy_rotation_center_;
 	auto from = Polycode::Vector3(from_xy.x, - from_xy.y, 0);
@@ -371,17 +356,13 @@ void BoneManipulation::OnPinchMove(cv::Point3f point) {
 }
 
 void BoneManipulation::RotateBy(Polycode::Quaternion const& diff) {
-	auto target = current_target_.load();
+	auto target = current_target_;
 	if (target == nullptr)
 		return;
 
-	Polycode::Quaternion parents, parents_inv;
-	auto parent = target->bone->getParentBone();
-	while (parent) {
-		parents = parent->getRotationQuat() * parents;
-		parents_inv = parents_inv * parent->getRotationQuat().Inverse();
-		parent = parent->getParentBone();
-	}
+	int64 start = cv::getTickCount();
+	auto parents = mesh_->flatSkeleton().parentRotation(target->bone_id);
+	auto parents_inv = parents.Inverse();
 	auto mesh_rot = mesh_->getRotationQuat();
 	auto new_quot = parents_inv * mesh_rot.Inverse() * diff * mesh_rot * parents * target->bone->getRotationQuat();
 	if (context_->model == Models::TREASURE) {
@@ -391,17 +372,23 @@ void BoneManipulation::RotateBy(Polycode::Quaternion const& diff) {
 			Polycode::Vector3(0, 0, 1));
 	}
 	target->bone->setRotationByQuaternion(new_quot);
-	mesh_->applyBoneMotion();
+	mesh_->markBoneDirty(target->bone_id);
+	int64 skinning_start = cv::getTickCount();
+	timings_.rotate += skinning_start - start;
+	mesh_->applyBoneMotion(SkinDirtyBones);
+	timings_.skinning += cv::getTickCount() - skinning_start;
 }
 
 void BoneManipulation::OnPinchEnd() {
-	auto target = current_target_.load();
+	if (journal_)
+		journal_->Write(PinchEndEvent, cv::Point3f());
+	auto target = current_target_;
 	if (!target)
 		return;
 
 	context_->writer->log() << "PinchEnd : " << target->handle_bone_id << std::endl;
 	target->marker->setColor(0.8, 0.5, 0.5, 0.8);
-	current_target_.store(nullptr);
+	current_target_ = nullptr;
 	pinch_end_sound_->Play();
 }
 
@@ -1,13 +1,15 @@
 #pragma once
-#include <atomic>
 #include <memory>
 #include <queue>
 #include <vector>
 
 #include <Polycode.h>
 
+#include "BoneCenters.h"
 #include "CameraEventListeners.h"
 #include "Models.h"
+#include "PinchFilter.h"
+#include "PinchJournal.h"
 
 namespace mobamas {
 
@@ -17,10 +19,19 @@ class PenPicker;
 
 struct BoneHandle {
 	Polycode::Bone* bone;
+	unsigned int bone_id;
 	Polycode::SceneMesh *marker;
 	unsigned int handle_bone_id;
 };
 
+// Time spent in each part of the manipulation, in ticks of cv::getTickCount.
+// Accumulated for profiling by PinchReplay.
+struct ManipulationTimings {
+	int64 rotate; // RotateBy except skinning
+	int64 skinning; // MeshGroup::applyBoneMotion
+	int64 handles; // handle markers and the rotation center in Update
+};
+
 struct MouseTiming {
 	Polycode::Vector2 position;
 	int timestamp;
@@ -35,6 +46,10 @@ public:
 	void OnPinchStart(cv::Point3f point);
 	void OnPinchMove(cv::Point3f point);
 	void OnPinchEnd();
+
+	// Record the pinch events given to this, including mouse and touch.
+	void set_journal(PinchJournalWriter* journal) { journal_ = journal; }
+	ManipulationTimings const& timings() const { return timings_; }
 	
 private:
 	std::shared_ptr<Context> context_;
@@ -44,15 +59,21 @@ private:
 	Polycode::Scene *scene_;
 	MeshGroup *mesh_;
 	std::vector<BoneHandle> handles_;
-	std::atomic<BoneHandle*> current_target_; // manipulated from different thread in RealSense mode
+	BoneCenters centers_; // of handle bones and their parents
+	BoneHandle* current_target_; // pinches from RealSense are delivered on the render thread by PinchEventQueue
 	Polycode::Vector2 pinch_offset;
 	Polycode::Vector2 xy_rotation_center_;
 	cv::Point3f pinch_prev_;
-	volatile bool require_xy_rotation_center_recalculation_ = false;
-	volatile bool capture_mouse_event_ = false;
-	std::deque<cv::Point3f> cached_points_;
+	bool require_xy_rotation_center_recalculation_ = false;
+	bool capture_mouse_event_ = false;
 	MouseTiming down_timing_;
+	// mouse and touch pinches; camera pinches are smoothed by PinchTracker
+	std::unique_ptr<PinchFilter> mouse_filter_;
+	bool mouse_pinching_ = false;
+	PinchJournalWriter* journal_ = nullptr;
+	ManipulationTimings timings_;
 
+	void StartMousePinch(Polycode::InputEvent* e);
 	BoneHandle* SelectHandleByWindowCoord(Polycode::Vector2 point, double allowed_error = 0.1);
 	void BoneManipulation::RotateBy(Polycode::Quaternion const& q);
 };
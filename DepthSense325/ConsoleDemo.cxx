@@ -1,10 +1,14 @@
 #include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
 
 #include "Context.h"
 #include "DepthMap.h"
 #include "EditorApp.h"
 #include "Models.h"
 #include "PenAsMouse.h"
+#include "PinchJournal.h"
 #include "Recorder.h"
 #include "RSClient.h"
 #include "Writer.h"
@@ -13,6 +17,30 @@
 #include "OutputDebugStringBuf.h"
 #endif
 
+// Arguments separated by spaces, or quoted with double quotes to contain them.
+static std::vector<std::string> SplitCommandLine(std::string const& command_line) {
+	std::vector<std::string> args;
+	std::string arg;
+	bool quoted = false, started = false;
+	for (auto c : command_line) {
+		if (c == '"') {
+			quoted = !quoted;
+			started = true;
+		} else if ((c == ' ' || c == '\t') && !quoted) {
+			if (started)
+				args.push_back(arg);
+			arg.clear();
+			started = false;
+		} else {
+			arg += c;
+			started = true;
+		}
+	}
+	if (started)
+		args.push_back(arg);
+	return args;
+}
+
 DWORD WINAPI RunRealSense(LPVOID lpParam) {
 	auto context = (mobamas::Context*)lpParam;
 	context->rs_client->Run();
@@ -37,11 +65,45 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 	auto context = std::make_shared<mobamas::Context>();
 	context->model = mobamas::Models::MIKU;
 	context->operation_mode = mobamas::OperationMode::MouseMode;
+	context->pinch_detector = mobamas::PinchDetector::RightEdgeDetector;
+
+	auto args = SplitCommandLine(lpCmdLine);
+	for (size_t i = 0; i < args.size(); i++) {
+		if (args[i] == "--replay" && i + 1 < args.size()) {
+			// "--replay journal_path" replays pinch_events.journal of a recording with its model and mode
+			context->replay_journal = args[++i];
+			mobamas::PinchJournalHeader header;
+			std::vector<mobamas::PinchJournalRecord> records;
+			if (!mobamas::ReadPinchJournal(context->replay_journal, header, records)) {
+				MessageBox(NULL, L"Failed to read the pinch journal", L"Replay", MB_ICONWARNING | MB_OK);
+				return 4;
+			}
+			context->model = static_cast<mobamas::Models>(header.model);
+			context->operation_mode = static_cast<mobamas::OperationMode>(header.operation_mode);
+		} else if (args[i] == "--animate") {
+			// loops the first animation of the model
+			context->play_animation = true;
+		} else if (args[i] == "--bench-picking") {
+			// writes picking_bench.json and quits
+			context->bench_picking = true;
+		} else {
+			std::cerr << "Unknown option " << args[i] << std::endl;
+		}
+	}
 	auto client = std::make_shared<mobamas::RSClient>(context);
 	context->rs_client = client;
-	context->writer = std::unique_ptr<mobamas::Writer>(new mobamas::Writer(context->model, context->operation_mode));
+	context->writer = std::make_shared<mobamas::Writer>(context->model, context->operation_mode);
 
-	context->writer->log() << "Start with model " << context->model << " operation mode " << context->operation_mode << std::endl;
+	context->writer->log() << "Start with model " << context->model << " operation mode " << context->operation_mode << " pinch detector " << context->pinch_detector << std::endl;
+
+	if (!context->replay_journal.empty()) {
+		// no editor to show, only its model
+		auto view = new Polycode::PolycodeView(hInstance, SW_HIDE, L"MOBAM@S");
+		mobamas::hWnd = view->hwnd;
+		bool replayed = mobamas::ReplayPinchJournal(view, context);
+		context->writer->log() << "End" << std::endl;
+		return replayed ? 0 : 4;
+	}
 
 	auto view = new Polycode::PolycodeView(hInstance, nCmdShow, L"MOBAM@S");
 	mobamas::hWnd = view->hwnd;
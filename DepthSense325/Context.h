@@ -1,7 +1,8 @@
 #pragma once
 #include <fstream>
 #include <memory>
-#include <opencv2\opencv.hpp>
+#include <string>
+#include <opencv2/opencv.hpp>
 
 #include "Models.h"
 
@@ -10,6 +11,8 @@ namespace mobamas {
 class RSClient;
 class PinchEventListener;
 class Writer;
+struct HoleTrack;
+struct PinchForest;
 
 enum OperationMode {
 	MouseMode,
@@ -18,12 +21,28 @@ enum OperationMode {
 	FrontMode,
 };
 
+enum PinchDetector {
+	RightEdgeDetector,
+	CenterOfHoleDetector,
+	DistanceTransformDetector,
+	PyramidX2Detector,
+	PyramidX4Detector,
+	TrackingDetector,
+	DecisionForestDetector,
+};
+
 struct Context {
 	Models model;
 	OperationMode operation_mode;
+	PinchDetector pinch_detector;
 	std::shared_ptr<RSClient> rs_client;
 	std::weak_ptr<PinchEventListener> pinch_listeners;
-	std::unique_ptr<Writer> writer;
+	std::shared_ptr<Writer> writer; // shared so that Context is usable without Writer definition
+	std::shared_ptr<HoleTrack> hole_track; // state of PinchRightEdgeTracking, see Algorithms.h
+	std::shared_ptr<const PinchForest> pinch_forest; // for PinchDecisionForest, see Algorithms.h
+	std::string replay_journal; // replay this instead of the camera and mouse, see PinchReplay
+	bool play_animation = false; // loop the first animation of the model, see AnimationPlayer
+	bool bench_picking = false; // benchmark picking on every model and quit, see PickingBench
 };
 
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 #include <stdint.h>
-#include <opencv2\opencv.hpp>
+#include <opencv2/opencv.hpp>
 
 namespace mobamas {
 
@@ -11,6 +11,7 @@ struct DepthMap {
 	cv::Mat normalized;
 	cv::Mat binary;  // binary image in which white is interested
 	cv::Point offset;
+	double timestamp; // capture time in seconds
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "DepthMapUtil.h"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include "DepthMap.h"
+
+namespace mobamas {
+
+void DisplayPinchMats(DepthMap const& depth_map, Option<cv::Point3f> const& pinch_point) {
+#if defined(_DEBUG) && !defined(MOBAMAS_HEADLESS)
+	IplImage *writeTo = cvCreateImage(cvSize(depth_map.w, depth_map.h), IPL_DEPTH_8U, 3);
+	auto roi = cv::Rect(depth_map.offset, depth_map.offset + cv::Point(depth_map.w, depth_map.h));
+	IplImage background = depth_map.normalized(roi);
+	cvMerge(&background, &background ,&background, NULL, writeTo);
+	auto binary = depth_map.binary(roi);
+	for (size_t i = 0; i < binary.total(); i++) {
+		writeTo->imageData[i * 3 + 2] = binary.at<uchar>(i) > 0 ? 0xff : 0;
+	}
+	if (pinch_point) {
+		cv::Point img_pt((*pinch_point).x * depth_map.w, (*pinch_point).y * depth_map.h);
+		cvCircle(writeTo, img_pt, 3, CV_RGB(255, 0, 60), -1);
+	}
+	cvShowImage("result", writeTo);
+	cvWaitKey(1);
+	cvReleaseImage(&writeTo);
+#endif
+}
+
+CvSeq* FindLargeHole(CvSeq* parent, double min_size) {
+	auto hole = parent->v_next;
+	while (hole) {
+		if (cvContourArea(hole) > min_size)
+			return hole;
+		hole = hole->h_next;
+	}
+	return NULL;
+}
+
+cv::Rect HandBoundingBox(cv::Mat const& binary) {
+	int left = binary.cols, top = binary.rows, right = -1, bottom = -1;
+	for (int y = 0; y < binary.rows; y++) {
+		auto ptr = binary.ptr<uchar>(y);
+		for (int x = 0; x < binary.cols; x++) {
+			if (ptr[x]) {
+				if (x < left) left = x;
+				if (x > right) right = x;
+				if (y < top) top = y;
+				bottom = y;
+			}
+		}
+	}
+	if (right < 0)
+		return cv::Rect();
+	return cv::Rect(left, top, right - left + 1, bottom - top + 1);
+}
+
+uint16_t DepthAtOrLeftOf(DepthMap const& data, cv::Point const& pt) {
+	uint16_t z = 0;
+	for (int x = pt.x; x >= 0 && z == 0; --x) {
+		z = data.raw_mat.at<uint16_t>(pt.y, x);
+	}
+	return z;
+}
+
+Option<cv::Point3f> ToPinchPoint(DepthMap const& data, cv::Point2f const& pt, float z) {
+	cv::Point center(data.offset.x + data.w / 2, data.offset.y + data.h / 2);
+	float rx = (pt.x - center.x) / static_cast<float>(data.w);
+	float ry = (pt.y - center.y) / static_cast<float>(data.h);
+	if (rx >= -0.5 && rx <= 0.5 && ry >= -0.5 && ry <= 0.5)
+		return Option<cv::Point3f>(cv::Point3f(0.5 + rx, 0.5 + ry, z));
+	return Option<cv::Point3f>::None();
+}
+
+void ReplaceFrontalOrigin(cv::Mat& raw_depth, cv::Mat& seg_mask, cv::Point& offset, uint16_t saturated, float kX, float kY, float kYOffset, uint16_t kZFar) {
+	assert(!raw_depth.empty());
+	assert(raw_depth.size() == seg_mask.size());
+	int cx = raw_depth.cols / 2, cy = raw_depth.rows / 2;
+	offset = cv::Point(raw_depth.cols / 2, raw_depth.rows / 2);
+
+	cv::Mat new_depth(raw_depth.rows * 2, raw_depth.cols * 2, raw_depth.type());
+	cv::Point max(new_depth.cols - offset.x - 1, new_depth.rows - offset.y - 1);
+	cv::Mat new_mask(new_depth.rows, new_depth.cols, seg_mask.type());
+	new_depth = saturated;
+	new_mask = 0;
+	for (size_t y = 0; y < raw_depth.rows - 1; y++) {
+		for (size_t x = 0; x < raw_depth.cols - 1; x++) {
+			auto z = raw_depth.at<uint16_t>(y, x);
+			auto z2 = raw_depth.at<uint16_t>(y+1, x+1);
+			if (z == saturated || z2 == saturated)
+				continue;
+			cv::Point ps(cx + kX * (static_cast<int>(x) - cx) * z, cy + kY * (static_cast<int>(y) - cy) * z - kYOffset * raw_depth.rows);
+			cv::Point pe(cx + kX * (static_cast<int>(x)+1 - cx) * z2, cy + kY * (static_cast<int>(y)+1 - cy) * z2 - kYOffset * raw_depth.rows);
+			if (pe.x < -offset.x || pe.y < -offset.y
+				|| ps.x > max.x || ps.y > max.y
+				|| ps.x > pe.x || ps.y > pe.y)
+				continue;
+			for (int ix = std::max(ps.x, -offset.x); ix <= std::min(pe.x, max.x); ++ix) {
+				for (int iy = std::max(ps.y, -offset.y); iy <= std::min(pe.y, max.y); ++iy) {
+					new_depth.at<uint16_t>(iy + offset.y, ix + offset.x) = std::max(kZFar - z, 0);
+					new_mask.at<uint8_t>(iy + offset.y, ix + offset.x) = seg_mask.at<uint8_t>(y, x);
+				}
+			}
+		}
+	}
+	raw_depth = new_depth;
+	seg_mask = new_mask;
+}
+
+uint16_t GetMinimumApplicableValue(cv::Mat depth) {
+	assert(!depth.empty());
+	uint16_t min = 0xffff;
+	for (size_t i = 0, length = depth.total(); i < length; i++)
+	{
+		auto v = depth.at<uint16_t>(i);
+		if (min > v && v > 0) min = v;
+	}
+	return min;
+}
+
+const char* kCorpusIndex = "/index.txt";
+
+bool WritePinchSample(std::string const& dir, std::string const& name, DepthMap const& depth_map, Option<cv::Point3f> const& truth, DepthSource const& source) {
+	cv::FileStorage fs(dir + "/" + name, cv::FileStorage::WRITE);
+	if (!fs.isOpened())
+		return false;
+	fs << "w" << depth_map.w << "h" << depth_map.h
+		<< "saturated_value" << static_cast<int>(depth_map.saturated_value)
+		<< "offset_x" << depth_map.offset.x << "offset_y" << depth_map.offset.y
+		<< "timestamp" << depth_map.timestamp
+		<< "raw_mat" << depth_map.raw_mat
+		<< "binary" << depth_map.binary
+		<< "pinching" << (truth ? 1 : 0);
+	if (truth) {
+		fs << "pinch_x" << (*truth).x << "pinch_y" << (*truth).y << "pinch_z" << (*truth).z;
+	}
+	if (!source.depth.empty()) {
+		fs << "operation_mode" << static_cast<int>(source.operation_mode)
+			<< "source_depth" << source.depth
+			<< "source_mask" << source.mask;
+	}
+	fs.release();
+
+	std::ofstream index(dir + kCorpusIndex, std::ios::out | std::ios::app);
+	if (!index.is_open())
+		return false;
+	index << name << std::endl;
+	return true;
+}
+
+bool ReadPinchSample(std::string const& path, DepthMap& depth_map, Option<cv::Point3f>& truth, DepthSource* source) {
+	cv::FileStorage fs(path, cv::FileStorage::READ);
+	if (!fs.isOpened())
+		return false;
+	depth_map.w = static_cast<int>(fs["w"]);
+	depth_map.h = static_cast<int>(fs["h"]);
+	depth_map.saturated_value = static_cast<uint16_t>(static_cast<int>(fs["saturated_value"]));
+	depth_map.offset = cv::Point(static_cast<int>(fs["offset_x"]), static_cast<int>(fs["offset_y"]));
+	depth_map.timestamp = static_cast<double>(fs["timestamp"]); // 0 in old corpora
+	fs["raw_mat"] >> depth_map.raw_mat;
+	fs["binary"] >> depth_map.binary;
+	if (depth_map.raw_mat.empty() || depth_map.binary.empty())
+		return false;
+	// normalized is only for debug display, and not recorded
+	depth_map.normalized = cv::Mat(depth_map.raw_mat.size(), CV_8UC1, cv::Scalar(0));
+	if (static_cast<int>(fs["pinching"])) {
+		truth.Reset(cv::Point3f(
+			static_cast<float>(fs["pinch_x"]),
+			static_cast<float>(fs["pinch_y"]),
+			static_cast<float>(fs["pinch_z"])));
+	} else {
+		truth.Clear();
+	}
+	if (source) {
+		// empty in corpora recorded before the source was added
+		source->operation_mode = static_cast<OperationMode>(static_cast<int>(fs["operation_mode"]));
+		fs["source_depth"] >> source->depth;
+		fs["source_mask"] >> source->mask;
+	}
+	return true;
+}
+
+std::vector<std::string> ListPinchCorpus(std::string const& dir) {
+	std::vector<std::string> result;
+	std::ifstream index(dir + kCorpusIndex);
+	std::string line;
+	while (std::getline(index, line)) {
+		if (!line.empty() && line[line.size() - 1] == '\r')
+			line.erase(line.size() - 1);
+		if (!line.empty())
+			result.push_back(dir + "/" + line);
+	}
+	return result;
+}
+
+}
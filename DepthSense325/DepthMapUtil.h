@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "Context.h"
+#include "Option.h"
+
+namespace mobamas {
+
+struct DepthMap;
+
+void DisplayPinchMats(DepthMap const& depth_map, Option<cv::Point3f> const& pinch_point);
+
+// Helpers of the pinch detection algorithms, see Algorithms.h.
+// The first hole of a contour found by cvFindContours with CV_RETR_TREE whose
+// area is larger than min_size in px, or null.
+CvSeq* FindLargeHole(CvSeq* parent, double min_size);
+// Bounding box of the white pixels of the binary image, empty if there are none.
+cv::Rect HandBoundingBox(cv::Mat const& binary);
+// Depth at pt of the raw image or, where the mask edge has none, at the nearest
+// pixel on its left that has one; 0 if none.
+uint16_t DepthAtOrLeftOf(DepthMap const& data, cv::Point const& pt);
+// The pinch point of pt in the binary image, as the algorithms return it, or
+// None outside the camera frame (see DepthMap::offset).
+Option<cv::Point3f> ToPinchPoint(DepthMap const& data, cv::Point2f const& pt, float z);
+
+// Preprocessing of camera frames in RSClient, shared with offline tuning.
+// Reprojects the depth as if seen from the front of the hand, into an image twice as large.
+void ReplaceFrontalOrigin(cv::Mat& raw_depth, cv::Mat& seg_mask, cv::Point& offset, uint16_t saturated, float kX, float kY, float kYOffset, uint16_t kZFar);
+uint16_t GetMinimumApplicableValue(cv::Mat depth);
+
+// Camera depth and blob mask before the preprocessing, to redo it with other parameters.
+struct DepthSource {
+	OperationMode operation_mode;
+	cv::Mat depth;
+	cv::Mat mask;
+};
+
+// Pinch corpus is a directory with index.txt listing one sample file per line.
+// Each sample is an OpenCV FileStorage holding a DepthMap and its annotated pinch
+// point (same coordinate as pinch detection algorithms return), so that labels
+// can be fixed by hand after recording. The source is optional (empty depth).
+bool WritePinchSample(std::string const& dir, std::string const& name, DepthMap const& depth_map, Option<cv::Point3f> const& truth, DepthSource const& source);
+bool ReadPinchSample(std::string const& path, DepthMap& depth_map, Option<cv::Point3f>& truth, DepthSource* source = nullptr);
+std::vector<std::string> ListPinchCorpus(std::string const& dir);
+
+}
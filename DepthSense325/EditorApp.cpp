@@ -1,5 +1,9 @@
 #include "EditorApp.h"
 
+#include <fstream>
+#include <sstream>
+
+#include "AnimationPlayer.h"
 #include "BoneManipulation.h"
 #include "Context.h"
 #include "HandVisualization.h"
@@ -8,6 +12,9 @@
 #include "ModelPainter.h"
 #include "Import.h"
 #include "PenPicker.h"
+#include "PickingBench.h"
+#include "PinchEventQueue.h"
+#include "PinchReplay.h"
 #include "Writer.h"
 
 namespace mobamas {
@@ -60,14 +67,25 @@ MeshGroup* LoadMesh2(Models model) {
 	}
 }
 
-EditorApp::EditorApp(PolycodeView *view, std::shared_ptr<Context> context) : context_(context) {
-	core_ = new POLYCODE_CORE(view, kWinWidth, kWinHeight, false, true, 0, 0, 90);
+static Polycode::Core* CreateCore(PolycodeView *view) {
+	auto core = new POLYCODE_CORE(view, kWinWidth, kWinHeight, false, true, 0, 0, 90);
 
-	core_->enableMouse(false);
+	core->enableMouse(false);
 
 	auto rm = Polycode::CoreServices::getInstance()->getResourceManager();
 	rm->addArchive("Resources/default.pak");
 	rm->addDirResource("default", false);
+	return core;
+}
+
+static void LookAtModel(Polycode::Scene* scene) {
+	auto cam = 	scene->getActiveCamera();
+	cam->setPosition(0, 0, 5);
+	cam->lookAt(Polycode::Vector3(0, 0, 0));
+}
+
+EditorApp::EditorApp(PolycodeView *view, std::shared_ptr<Context> context) : context_(context) {
+	core_ = CreateCore(view);
 
 	auto scene = new Polycode::Scene();
 
@@ -103,10 +121,7 @@ EditorApp::EditorApp(PolycodeView *view, std::shared_ptr<Context> context) : con
 	light->setPosition(7, -7, 7);
 	scene->addLight(light);
 	scene->enableLighting(true);
-
-	auto cam = 	scene->getActiveCamera();
-	cam->setPosition(0, 0, 5);
-	cam->lookAt(Polycode::Vector3(0, 0, 0));
+	LookAtModel(scene);
 
 	if (context->operation_mode == OperationMode::MidAirMode || context->operation_mode == OperationMode::FrontMode) {
 		hand_visualization_.reset(new HandVisualization(scene, context->rs_client));
@@ -116,7 +131,13 @@ EditorApp::EditorApp(PolycodeView *view, std::shared_ptr<Context> context) : con
 	painter_.reset(new ModelPainter(context, scene, mesh_, picker));
 	rotation_.reset(new ModelRotation(context, mesh_, mihon_));
 
-	context->pinch_listeners = bone_manipulation_;
+	// pinches from the sensor thread are applied in Update, not to race with rendering
+	pinch_events_ = std::make_shared<PinchEventQueue>();
+	context->pinch_listeners = pinch_events_;
+	if (context->play_animation && !mesh_->getAnimations().empty()) {
+		animation_.reset(new AnimationPlayer(mesh_, 0));
+	}
+	bone_manipulation_->set_journal(&context->writer->journal());
 }
 
 EditorApp::~EditorApp() {
@@ -126,9 +147,34 @@ EditorApp::~EditorApp() {
 		delete core_;
 }
 
+static void RunPickingBench() {
+	const Models models[] = { Models::MIKU, Models::TREASURE, Models::DOG, Models::TV, Models::BIRD };
+	const char* names[] = { "miku", "treasure", "dog", "tv", "bird" };
+	std::ostringstream lines;
+	for (int i = 0; i < sizeof(models) / sizeof(models[0]); i++) {
+		auto group = LoadMesh2(models[i]);
+		if (!group)
+			continue;
+		BenchPicking(names[i], group, lines);
+		delete group;
+	}
+	std::ofstream report("picking_bench.json");
+	report << lines.str();
+	std::cout << lines.str();
+}
+
 const unsigned int kAutoSaveDuration = 5000; // ms
 bool EditorApp::Update() {
+	if (context_->bench_picking) {
+		RunPickingBench();
+		return false;
+	}
+	pinch_events_->Drain(*bone_manipulation_);
 	bone_manipulation_->Update();
+	if (animation_)
+		animation_->Update(core_->getTicks() / 1000.0);
+	// for picking and painting on the paint worker
+	mesh_->updateWorldVertices();
 	if (hand_visualization_)
 		hand_visualization_->Update();
 	painter_->Update();
@@ -150,4 +196,28 @@ void EditorApp::Shutdown() {
 	painter_->Shutdown();
 }
 
+bool ReplayPinchJournal(PolycodeView *view, std::shared_ptr<Context> context) {
+	PinchReplay replay(context->replay_journal);
+	if (!replay.loaded())
+		return false;
+	std::unique_ptr<Polycode::Core> core(CreateCore(view));
+	auto scene = new Polycode::Scene();
+	std::unique_ptr<MeshGroup> mesh(LoadMesh2(context->model));
+	if (!mesh)
+		return false;
+	scene->addEntity(mesh.get());
+	LookAtModel(scene);
+
+	auto picker = new PenPicker(context);
+	BoneManipulation manipulation(context, scene, mesh.get(), context->model, picker);
+	while (replay.Step(manipulation)) {
+	}
+	scene->removeEntity(mesh.get());
+
+	std::ofstream report(context->replay_journal + ".replay.json");
+	replay.WriteReport(report);
+	replay.WriteReport(std::cout);
+	return true;
+}
+
 }
\ No newline at end of file
@@ -9,11 +9,13 @@ namespace mobamas {
 	const int kWinWidth = 800;// 1080 / 1.5;
 
 struct Context;
+class AnimationPlayer;
 class BoneManipulation;
 class HandVisualization;
 class MeshGroup;
 class ModelRotation;
 class ModelPainter;
+class PinchEventQueue;
 
 class EditorApp {
 public:
@@ -28,10 +30,18 @@ private:
 	MeshGroup* mihon_;
 	std::shared_ptr<Context> context_;
 	std::shared_ptr<BoneManipulation> bone_manipulation_;
+	std::shared_ptr<PinchEventQueue> pinch_events_;
+	std::unique_ptr<AnimationPlayer> animation_;
 	std::unique_ptr<HandVisualization> hand_visualization_;
 	std::unique_ptr<ModelRotation> rotation_;
 	std::unique_ptr<ModelPainter> painter_;
 	unsigned int last_save_tick_ = 0;
 };
 
+// Replays context->replay_journal into BoneManipulation on the model alone, with the
+// events back to back and without rendering or the other parts of EditorApp. Polycode
+// still needs a core to load the model and project bones, so the view may be hidden.
+// Writes the report of PinchReplay next to the journal and to stdout.
+bool ReplayPinchJournal(Polycode::PolycodeView *view, std::shared_ptr<Context> context);
+
 }
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include "FlatSkeleton.h"
+
+#include <algorithm>
+
+#include "Skinning.h"
+
+namespace mobamas {
+
+FlatSkeleton::FlatSkeleton(Polycode::Skeleton* skeleton) {
+	int n = skeleton->getNumBones();
+	bones_.resize(n);
+	parents_.resize(n);
+	rest_.resize(n);
+	world_.resize(n);
+	world_rotation_.resize(n);
+	dirty_.assign(n, true);
+	std::vector<int> depths(n);
+	for (int i = 0; i < n; i++) {
+		auto bone = bones_[i] = skeleton->getBone(i);
+		auto parent = bone->getParentBone();
+		parents_[i] = parent ? skeleton->getBoneIndexByBone(parent) : -1;
+		rest_[i] = bone->getRestMatrix();
+		for (auto p = parent; p; p = p->getParentBone())
+			depths[i]++;
+	}
+	for (int i = 0; i < n; i++)
+		order_.push_back(i);
+	std::stable_sort(order_.begin(), order_.end(), [&](int a, int b) { return depths[a] < depths[b]; });
+}
+
+void FlatSkeleton::Update(std::vector<float>& palette) {
+	palette.resize(bones_.size() * kPaletteStride);
+	// a bone is recomputed if it or an ancestor is dirty
+	std::vector<bool> changed(bones_.size(), false);
+	for (auto i : order_) {
+		int parent = parents_[i];
+		if (!dirty_[i] && (parent < 0 || !changed[parent]))
+			continue;
+		changed[i] = true;
+		auto bone = bones_[i];
+		if (dirty_[i])
+			bone->rebuildTransformMatrix();
+		// as Polycode::Bone::rebuildFinalMatrix, for row vectors
+		world_[i] = parent < 0 ? bone->getTransformMatrix() : bone->getTransformMatrix() * world_[parent];
+		world_rotation_[i] = parent < 0 ? bone->getRotationQuat() : world_rotation_[parent] * bone->getRotationQuat();
+		bone->finalMatrix = rest_[i] * world_[i];
+
+		// Polycode multiplies row vectors, so the rows of the palette are the columns
+		auto const& m = bone->finalMatrix.m;
+		auto entry = &palette[i * kPaletteStride];
+		for (int r = 0; r < 3; r++)
+			for (int c = 0; c < 4; c++)
+				entry[r * 4 + c] = m[c][r];
+	}
+	dirty_.assign(dirty_.size(), false);
+}
+
+Polycode::Quaternion const& FlatSkeleton::parentRotation(int bone) const {
+	int parent = parents_[bone];
+	return parent < 0 ? identity_ : world_rotation_[parent];
+}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <Polycode.h>
+
+namespace mobamas {
+
+// Bones of a Polycode::Skeleton flattened into arrays indexed like the skeleton,
+// with the world transforms cached so that only the subtrees of changed bones are
+// recomputed, instead of every bone by Skeleton::Update.
+class FlatSkeleton {
+public:
+	FlatSkeleton() {}
+	explicit FlatSkeleton(Polycode::Skeleton* skeleton);
+	int size() const { return static_cast<int>(bones_.size()); }
+	int parent(int bone) const { return parents_[bone]; }
+
+	// Call when the local transform of bone is changed.
+	void markDirty(int bone) { dirty_[bone] = true; }
+	void markAllDirty() { dirty_.assign(dirty_.size(), true); }
+	// Recompute the dirty bones and their descendants, update finalMatrix of them
+	// and their rows in palette (see Skinning.h), and clear the dirty flags.
+	void Update(std::vector<float>& palette);
+
+	// Rotation of the parent of bone relative to the root, as of the last Update.
+	Polycode::Quaternion const& parentRotation(int bone) const;
+
+private:
+	std::vector<Polycode::Bone*> bones_;
+	std::vector<int> parents_; // -1 for roots
+	std::vector<int> order_; // parents before children
+	std::vector<Polycode::Matrix4> rest_, world_;
+	std::vector<Polycode::Quaternion> world_rotation_;
+	std::vector<bool> dirty_;
+	Polycode::Quaternion identity_;
+};
+
+}
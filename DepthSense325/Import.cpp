@@ -4,10 +4,17 @@
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <mutex>
 #include <unordered_map>
 #include <iostream>
 
+#include "Animation.h"
+#include "Skinning.h"
+#include "WorkerPool.h"
+
 #if _MSC_VER
 #include <filesystem>
 namespace filesystem = std::tr2::sys;
@@ -20,22 +27,45 @@ namespace mobamas {
 
 class EnhSceneMesh : public Polycode::SceneMesh {
 public:
-	EnhSceneMesh(int mesh_type) : SceneMesh(mesh_type), 
-		original_position_array_(Polycode::RenderDataArray::VERTEX_DATA_ARRAY),
-		original_normal_array_(Polycode::RenderDataArray::NORMAL_DATA_ARRAY) {}
-
-	void saveOriginal() {
-		original_position_array_ = mesh->vertexPositionArray;
-		original_normal_array_ = mesh->vertexNormalArray;
+	EnhSceneMesh(int mesh_type) : SceneMesh(mesh_type) {}
+
+	// Call after the bone weights are normalized. bone_parents as BuildBoneInfluences.
+	void saveOriginal(std::vector<int> const& bone_parents) {
+		auto raw = getMesh();
+		bool has_normals = raw->vertexNormalArray.data.size() == raw->vertexPositionArray.data.size();
+		BuildSkinningMesh(raw->vertexPositionArray.data.size() / 3,
+			raw->vertexPositionArray.data.data(),
+			has_normals ? raw->vertexNormalArray.data.data() : nullptr,
+			raw->vertexBoneWeightArray.data.data(),
+			raw->vertexBoneIndexArray.data.data(),
+			skinning_);
+		BuildBoneInfluences(bone_parents, skinning_);
 	}
 
-	Polycode::VertexDataArray const& original_position_array() { return original_position_array_; }
+	SkinningMesh const& skinning() { return skinning_; }
+
+	// Build the hierarchy for picking on the current pose; later poses refit it.
+	void buildBvh() {
+		auto raw = getMesh();
+		auto const& data = raw->vertexPositionArray.data;
+		std::vector<Polycode::Vector3> positions(data.size() / 3);
+		for (size_t v = 0; v < positions.size(); v++)
+			positions[v] = Polycode::Vector3(data[v * 3], data[v * 3 + 1], data[v * 3 + 2]);
+		auto built = std::make_shared<std::vector<unsigned int>>(raw->indexArray.data.begin(), raw->indexArray.data.end());
+		bvh = std::make_shared<TriangleBvh>(positions, *built);
+		indices = built;
+	}
+	std::shared_ptr<const TriangleBvh> bvh;
+	std::shared_ptr<const std::vector<unsigned int>> indices;
 
-	Polycode::VertexDataArray const& original_normal_array() { return original_normal_array_; }
+	// see MeshGroup::updateWorldVertices
+	unsigned int world_pose_version = 0;
+	Polycode::Matrix4 world_transform;
+	std::mutex m_world;
+	std::shared_ptr<const WorldVertices> world;
 
 private:
-	Polycode::VertexDataArray original_position_array_;
-	Polycode::VertexDataArray original_normal_array_;
+	SkinningMesh skinning_;
 };
 
 struct BoneAssignment {
@@ -64,48 +94,77 @@ Polycode::Material* createMaterial(std::string name) {
 	return mat;
 }
 
-MeshGroup::MeshGroup() : Polycode::Entity(), wrapper_(new Polycode::Entity()) {
+// Skinning is split into tasks of kSkinningChunk vertices (a multiple of 4), run
+// on MainWorkerPool when the group has kParallelSkinningVertices or more.
+const int kSkinningChunk = 4096;
+const int kParallelSkinningVertices = 16384;
+
+MeshGroup::MeshGroup() : Polycode::Entity(), wrapper_(new Polycode::Entity()), skeleton_(nullptr) {
 	addChild(wrapper_);
 }
 
+void MeshGroup::markBoneDirty(int bone) {
+	if (!skeleton_)
+		return;
+	dirty_bones_.resize(skeleton_->getNumBones());
+	dirty_bones_[bone] = true;
+	if (flat_skeleton_.size() == dirty_bones_.size())
+		flat_skeleton_.markDirty(bone);
+}
+
 // FIXME: misbehave against models without bone weights
-void MeshGroup::applyBoneMotion() {
+void MeshGroup::applyBoneMotion(SkinningMode mode) {
 	if (!skeleton_)
 		return;
-	skeleton_->Update();
+	if (flat_skeleton_.size() != skeleton_->getNumBones())
+		flat_skeleton_ = FlatSkeleton(skeleton_);
+	if (mode == SkinAllBones)
+		flat_skeleton_.markAllDirty();
+	flat_skeleton_.Update(palette_);
+
+	// split the vertices to skin into ranges
+	struct Task {
+		EnhSceneMesh* mesh;
+		SkinningBucket const* bucket;
+		int begin, end;
+	};
+	std::vector<Task> tasks;
+	int total = 0;
+	VertexRanges ranges;
 	for (auto child : getSceneMeshes()) {
 		auto mesh = static_cast<EnhSceneMesh*>(child);
-		auto raw = mesh->getMesh();
-		auto parr = mesh->original_position_array();
-		auto narr = mesh->original_normal_array();
-		for (int vidx = 0; vidx < raw->vertexPositionArray.data.size() / 3; vidx++) {
-			Polycode::Vector3 rest_vert(parr.data[vidx * 3],
-				parr.data[vidx * 3 + 1],
-				parr.data[vidx * 3 + 2]);
-			Polycode::Vector3 nvec(narr.data[vidx * 3], 
-				narr.data[(vidx * 3) + 1], 
-				narr.data[(vidx * 3) + 2]);
-			Polycode::Vector3 real_pos, norm;
-			for (int b = 0; b < 4; b++)
-			{
-				auto bidx = vidx * 4 + b;
-				auto weight = raw->vertexBoneWeightArray.data[bidx];
-				if (weight > 0.0) {
-					auto bone = getSkeleton()->getBone(raw->vertexBoneIndexArray.data[bidx]);
-					real_pos += bone->finalMatrix * rest_vert * weight;
-					norm += bone->finalMatrix.rotateVector(nvec) * weight;
+		for (auto const& bucket : mesh->skinning().buckets) {
+			if (mode == SkinDirtyBones) {
+				CollectDirtyRanges(bucket, dirty_bones_, ranges);
+			} else {
+				VertexRange all = { 0, bucket.count };
+				ranges.assign(1, all);
+			}
+			for (auto const& range : ranges) {
+				for (int begin = range.begin; begin < range.end; begin += kSkinningChunk) {
+					Task task = { mesh, &bucket, begin, std::min(range.end, begin + kSkinningChunk) };
+					tasks.push_back(task);
 				}
+				total += range.end - range.begin;
 			}
-			raw->vertexPositionArray.data[vidx * 3] = real_pos.x;
-			raw->vertexPositionArray.data[vidx * 3 + 1] = real_pos.y;
-			raw->vertexPositionArray.data[vidx * 3 + 2] = real_pos.z;
-
-			norm.Normalize();
-			raw->vertexNormalArray.data[vidx * 3] = norm.x;
-			raw->vertexNormalArray.data[vidx * 3 + 1] = norm.y;
-			raw->vertexNormalArray.data[vidx * 3 + 2] = norm.z;
 		}
 	}
+	dirty_bones_.assign(dirty_bones_.size(), false);
+	pose_version_++;
+	auto skin = [&](int i) {
+		auto const& task = tasks[i];
+		auto raw = task.mesh->getMesh();
+		bool has_normals = raw->vertexNormalArray.data.size() == raw->vertexPositionArray.data.size();
+		SkinVertices(*task.bucket, palette_.data(), task.begin, task.end,
+			raw->vertexPositionArray.data.data(),
+			has_normals ? raw->vertexNormalArray.data.data() : nullptr);
+	};
+	if (total < kParallelSkinningVertices) {
+		for (int i = 0, n = tasks.size(); i < n; i++)
+			skin(i);
+	} else {
+		MainWorkerPool().ParallelFor(tasks.size(), skin);
+	}
 }
 
 void MeshGroup::centralize() {
@@ -150,6 +209,70 @@ std::vector<Polycode::SceneMesh*> MeshGroup::getSceneMeshes() {
 	return result;
 }
 
+static unsigned int world_vertices_version = 0;
+
+void WorldVertices::refit() const {
+	std::call_once(refitted_, [this]() {
+		if (bvh)
+			bvh->Refit(positions, bvh_boxes_, bvh_triangles_);
+	});
+}
+
+std::vector<BvhBox> const& WorldVertices::bvhBoxes() const {
+	refit();
+	return bvh_boxes_;
+}
+
+std::vector<float> const& WorldVertices::bvhTriangles() const {
+	refit();
+	return bvh_triangles_;
+}
+
+// Only the positions; the hierarchy is refitted on demand, see WorldVertices.
+static std::shared_ptr<const WorldVertices> BuildWorldVertices(EnhSceneMesh* mesh, Polycode::Matrix4 const& transform) {
+	auto raw = mesh->getMesh();
+	auto world = std::make_shared<WorldVertices>();
+	world->version = ++world_vertices_version;
+	auto const& data = raw->vertexPositionArray.data;
+	world->positions.resize(data.size() / 3);
+	for (size_t v = 0; v < world->positions.size(); v++) {
+		world->positions[v] = transform * Polycode::Vector3(data[v * 3], data[v * 3 + 1], data[v * 3 + 2]);
+	}
+	world->bvh = mesh->bvh;
+	world->indices = mesh->indices;
+	return world;
+}
+
+std::shared_ptr<const WorldVertices> MeshGroup::updateWorldVertices(Polycode::SceneMesh* child) {
+	auto mesh = static_cast<EnhSceneMesh*>(child);
+	auto transform = mesh->getConcatenatedMatrix();
+	if (mesh->world && mesh->world_pose_version == pose_version_
+		&& std::memcmp(mesh->world_transform.ml, transform.ml, sizeof(transform.ml)) == 0) {
+		return mesh->world;
+	}
+	auto world = BuildWorldVertices(mesh, transform);
+	mesh->world_pose_version = pose_version_;
+	mesh->world_transform = transform;
+	std::lock_guard<std::mutex> lock(mesh->m_world);
+	mesh->world = world;
+	return world;
+}
+
+void MeshGroup::updateWorldVertices() {
+	for (auto mesh : getSceneMeshes())
+		updateWorldVertices(mesh);
+}
+
+SkinningMesh const& MeshGroup::skinning(Polycode::SceneMesh* mesh) {
+	return static_cast<EnhSceneMesh*>(mesh)->skinning();
+}
+
+std::shared_ptr<const WorldVertices> MeshGroup::worldVertices(Polycode::SceneMesh* child) {
+	auto mesh = static_cast<EnhSceneMesh*>(child);
+	std::lock_guard<std::mutex> lock(mesh->m_world);
+	return mesh->world;
+}
+
 class ModelLoader {
 public:
 	ModelLoader(std::string path) : file_path_(path) {}
@@ -163,6 +286,7 @@ private:
 	bool bone_assignments_cached_;
 	int mesh_index_ = -1;
 	bool has_weight_;
+	std::vector<int> bone_parents_;
 	std::unordered_map<const char*, unsigned int> bone_id_cache_;
 
 	unsigned int ModelLoader::getBoneID(aiString const& name);
@@ -170,6 +294,7 @@ private:
 	Polycode::Bone* buildSkeleton(Polycode::Bone *parent, const struct aiNode* nd);
 	void loadBoneAssignmentsCache();
 	void saveBoneAssignmentsCache();
+	void loadAnimations();
 };
 
 unsigned int ModelLoader::getBoneID(aiString const& name) {
@@ -281,7 +406,6 @@ void ModelLoader::buildMesh(const struct aiNode* nd) {
 				ass.weights[3], ass.boneIds[3]);
 			tmesh->addVertex(mesh->mVertices[index].x, mesh->mVertices[index].y, mesh->mVertices[index].z);
 		}
-		scene_mesh->saveOriginal();
 
 		for (size_t t = 0; t < mesh->mNumFaces; ++t) {
 			const struct aiFace* face = &mesh->mFaces[t];
@@ -299,6 +423,7 @@ void ModelLoader::buildMesh(const struct aiNode* nd) {
 		if (tmesh->vertexBoneIndexArray.getDataSize() > 0) {
 			tmesh->normalizeBoneWeights();
 		}
+		scene_mesh->saveOriginal(bone_parents_);
 
 
 		aiVector3D p;
@@ -495,6 +620,62 @@ void ModelLoader::saveBoneAssignmentsCache() {
 	}
 }
 
+const double kDefaultTicksPerSecond = 25; // as Assimp viewers, when the file has none
+const float kAnimationFrameRate = 60;
+
+void ModelLoader::loadAnimations() {
+	auto skeleton = group_->getSkeleton();
+	for (unsigned int a = 0; a < sc_->mNumAnimations; a++) {
+		auto ai_anim = sc_->mAnimations[a];
+		double ticks = ai_anim->mTicksPerSecond > 0 ? ai_anim->mTicksPerSecond : kDefaultTicksPerSecond;
+		SkeletalAnimation animation;
+		animation.name = ai_anim->mName.C_Str();
+		animation.duration = static_cast<float>(ai_anim->mDuration / ticks);
+		for (unsigned int c = 0; c < ai_anim->mNumChannels; c++) {
+			auto channel = ai_anim->mChannels[c];
+			auto bone = skeleton->getBoneByName(channel->mNodeName.C_Str());
+			if (!bone)
+				continue;
+			BoneTrack track;
+			track.bone = skeleton->getBoneIndexByBone(bone);
+			for (unsigned int k = 0; k < channel->mNumRotationKeys; k++) {
+				auto const& key = channel->mRotationKeys[k];
+				track.rotation_times.push_back(static_cast<float>(key.mTime / ticks));
+				track.rotations.push_back(key.mValue.w);
+				track.rotations.push_back(key.mValue.x);
+				track.rotations.push_back(key.mValue.y);
+				track.rotations.push_back(key.mValue.z);
+			}
+			if (track.rotation_times.empty()) {
+				track.rotation_times.push_back(0);
+				track.rotations.push_back(bone->baseRotation.w);
+				track.rotations.push_back(bone->baseRotation.x);
+				track.rotations.push_back(bone->baseRotation.y);
+				track.rotations.push_back(bone->baseRotation.z);
+			}
+			for (unsigned int k = 0; k < channel->mNumPositionKeys; k++) {
+				auto const& key = channel->mPositionKeys[k];
+				track.position_times.push_back(static_cast<float>(key.mTime / ticks));
+				track.positions.push_back(key.mValue.x);
+				track.positions.push_back(key.mValue.y);
+				track.positions.push_back(key.mValue.z);
+			}
+			if (track.position_times.empty()) {
+				track.position_times.push_back(0);
+				track.positions.push_back(bone->basePosition.x);
+				track.positions.push_back(bone->basePosition.y);
+				track.positions.push_back(bone->basePosition.z);
+			}
+			animation.tracks.push_back(track);
+		}
+		// bones in skeleton order keep the frames walking the bones forward
+		std::sort(animation.tracks.begin(), animation.tracks.end(),
+			[](BoneTrack const& a, BoneTrack const& b) { return a.bone < b.bone; });
+		ResampleAnimation(animation, kAnimationFrameRate);
+		group_->addAnimation(animation);
+	}
+}
+
 MeshGroup* ModelLoader::loadMesh() {
 	Assimp::Importer importer;
 	sc_ = importer.ReadFile(file_path_, aiProcess_Triangulate | aiProcess_ValidateDataStructure | aiProcess_FindInvalidData);
@@ -508,6 +689,11 @@ MeshGroup* ModelLoader::loadMesh() {
 
 	// skeleton must be built first to construct bone id list
 	buildSkeleton(NULL, sc_->mRootNode);
+	auto skeleton = group_->getSkeleton();
+	for (unsigned int i = 0; i < skeleton->getNumBones(); i++) {
+		auto parent = skeleton->getBone(i)->getParentBone();
+		bone_parents_.push_back(parent ? skeleton->getBoneIndexByBone(parent) : -1);
+	}
 	has_weight_ = false;
 	loadBoneAssignmentsCache();
 	buildMesh(sc_->mRootNode);
@@ -515,12 +701,16 @@ MeshGroup* ModelLoader::loadMesh() {
 	if (!has_weight_)
 		group_->setSkeleton(nullptr);
 
-	if (sc_->HasAnimations()) {
-		std::cerr << "Animation is not yet supported." << std::endl;
+	if (sc_->HasAnimations() && group_->getSkeleton()) {
+		loadAnimations();
 	}
 
 	// init position
 	group_->applyBoneMotion();
+	auto meshes = group_->getSceneMeshes();
+	MainWorkerPool().ParallelFor(static_cast<int>(meshes.size()), [&](int i) {
+		static_cast<EnhSceneMesh*>(meshes[i])->buildBvh();
+	});
 
 	return group_;
 }
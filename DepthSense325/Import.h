@@ -1,14 +1,54 @@
 #pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <Polycode.h>
 
+#include "Animation.h"
+#include "FlatSkeleton.h"
+#include "TriangleBvh.h"
+
 namespace mobamas {
 
+struct SkinningMesh;
+
+// World-space vertex positions of a SceneMesh in one pose and transform. Never
+// modified once published, so any thread may keep and read it. The hierarchy,
+// which only picking needs, is refitted on the first call of bvhBoxes or
+// bvhTriangles, once per snapshot.
+struct WorldVertices {
+	unsigned int version; // differs whenever the pose or the transform does
+	std::vector<Polycode::Vector3> positions;
+	std::shared_ptr<const TriangleBvh> bvh; // built at load, shared by every pose
+	std::shared_ptr<const std::vector<unsigned int>> indices; // indexArray, shared by every pose
+
+	// bvh refitted to positions, and the triangles packed in the order of bvh
+	// (see TrianglePackets.h).
+	std::vector<BvhBox> const& bvhBoxes() const;
+	std::vector<float> const& bvhTriangles() const;
+
+private:
+	void refit() const;
+
+	mutable std::once_flag refitted_;
+	mutable std::vector<BvhBox> bvh_boxes_;
+	mutable std::vector<float> bvh_triangles_;
+};
+
+enum SkinningMode {
+	SkinAllBones,
+	SkinDirtyBones, // only vertices moved by bones given to markBoneDirty
+};
+
 class MeshGroup : public Polycode::Entity {
 public:
 	MeshGroup();
 	void setSkeleton(Polycode::Skeleton* s) { skeleton_ = s; }
 	Polycode::Skeleton* getSkeleton() { return skeleton_; }
-	void applyBoneMotion();
+	// Call with the index in the skeleton of a bone whose transform is changed.
+	// Only changed bones are recomputed, and only their vertices for SkinDirtyBones.
+	void markBoneDirty(int bone);
+	void applyBoneMotion(SkinningMode mode = SkinAllBones);
 
 	// adjust position to balance top and bottom region. Call right after first applyBoneMotion()
 	void centralize();
@@ -16,9 +56,31 @@ public:
 	void addSceneMesh(Polycode::SceneMesh* newChild);
 	std::vector<Polycode::SceneMesh*> getSceneMeshes();
 
+	// Recompute the world vertices of a mesh of this group if the pose or its
+	// transform has changed since the last call, and return them. Main thread only.
+	std::shared_ptr<const WorldVertices> updateWorldVertices(Polycode::SceneMesh* mesh);
+	void updateWorldVertices();
+	// Rest pose and bone weights of a mesh of this group, see Skinning.h.
+	SkinningMesh const& skinning(Polycode::SceneMesh* mesh);
+	// Bone matrices of the last applyBoneMotion, see Skinning.h.
+	std::vector<float> const& palette() const { return palette_; }
+	void addAnimation(SkeletalAnimation const& animation) { animations_.push_back(animation); }
+	std::vector<SkeletalAnimation> const& getAnimations() const { return animations_; }
+
+	// Cached world transforms of the skeleton as of the last applyBoneMotion.
+	FlatSkeleton const& flatSkeleton() const { return flat_skeleton_; }
+	// The last world vertices computed by updateWorldVertices, or null before
+	// the first call. Any thread.
+	std::shared_ptr<const WorldVertices> worldVertices(Polycode::SceneMesh* mesh);
+
 private:
 	Polycode::Entity* wrapper_;
 	Polycode::Skeleton* skeleton_;
+	FlatSkeleton flat_skeleton_;
+	std::vector<SkeletalAnimation> animations_;
+	std::vector<float> palette_; // see Skinning.h
+	std::vector<bool> dirty_bones_;
+	unsigned int pose_version_ = 0;
 };
 
 MeshGroup* importCollada(std::string path);
@@ -1,6 +1,6 @@
 #include "Intersection.h"
 
-#include "Util.h"
+#include "Import.h"
 
 namespace mobamas {
 
@@ -46,14 +46,53 @@ Intersection CalculateIntersectionPoint(const Polycode::Ray& ray,
 	return res;
 }
 
-Intersection FindIntersectionPolygon(vector<Polycode::SceneMesh*> const& meshes, const Polycode::Ray& ray) {
+// The nearest of the hits of raycast on each mesh.
+template <typename Raycast>
+static Intersection FindNearest(MeshGroup* group, const Polycode::Ray& ray, Raycast raycast) {
 	Intersection best;
 	best.found = false;
 	double distance = 1e10;
 
-	for (auto mesh : meshes) {
+	for (auto mesh : group->getSceneMeshes()) {
+		auto world = group->worldVertices(mesh);
+		if (!world || !world->bvh)
+			continue;
+		auto res = raycast(*world);
+		if (res.found) {
+			res.scene_mesh = mesh;
+			auto this_dist = res.point.distance(ray.origin);
+			if (distance > this_dist) {
+				best = std::move(res);
+				distance = this_dist;
+			}
+		}
+	}
+	return best;
+}
+
+Intersection FindIntersectionPolygon(MeshGroup* group, const Polycode::Ray& ray) {
+	return FindNearest(group, ray, [&](WorldVertices const& world) {
+		return world.bvh->Raycast(ray, world.bvhBoxes(), world.bvhTriangles());
+	});
+}
+
+Intersection FindIntersectionPolygonBruteForce(MeshGroup* group, const Polycode::Ray& ray) {
+	return FindNearest(group, ray, [&](WorldVertices const& world) {
+		return world.bvh->RaycastAll(ray, world.bvhTriangles());
+	});
+}
+
+Intersection FindIntersectionPolygonScalar(MeshGroup* group, const Polycode::Ray& ray) {
+	Intersection best;
+	best.found = false;
+	double distance = 1e10;
+
+	for (auto mesh : group->getSceneMeshes()) {
 		auto raw = mesh->getMesh();
-		std::vector<Polycode::Vector3> adjusted_points = ActualVertexPositions(mesh);
+		auto world = group->worldVertices(mesh);
+		if (!world)
+			continue;
+		auto const& adjusted_points = world->positions;
 		int step = raw->getIndexGroupSize();
 		for (int ii = 0; ii < raw->getIndexCount(); ii += step) {
 			auto idx0 = raw->indexArray.data[ii],
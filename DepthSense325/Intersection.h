@@ -4,6 +4,8 @@
 
 namespace mobamas {
 
+class MeshGroup;
+
 // http://geomalgorithms.com/a06-_intersect-2.html#intersect3D_RayTriangle()
 struct Intersection {
 	bool found;
@@ -17,6 +19,12 @@ Intersection CalculateIntersectionPoint(
 	const Polycode::Vector3& v0,
 	const Polycode::Vector3& v1,
 	const Polycode::Vector3& v2);
-Intersection FindIntersectionPolygon(vector<Polycode::SceneMesh*> const& meshes, const Polycode::Ray& ray);
+// On the world vertices last published by the group; any thread.
+Intersection FindIntersectionPolygon(MeshGroup* group, const Polycode::Ray& ray);
+// As FindIntersectionPolygon testing every triangle with the same kernel.
+Intersection FindIntersectionPolygonBruteForce(MeshGroup* group, const Polycode::Ray& ray);
+// As FindIntersectionPolygon by CalculateIntersectionPoint on every triangle,
+// the reference for the others.
+Intersection FindIntersectionPolygonScalar(MeshGroup* group, const Polycode::Ray& ray);
 
 }
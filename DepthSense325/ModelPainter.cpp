@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include <ctime>
+#include <map>
 #include <mutex>
 #include <unordered_set>
 #include <opencv2\opencv.hpp>
@@ -10,24 +11,20 @@
 #include "Context.h"
 #include "EditorApp.h"
 #include "Import.h"
-#include "Intersection.h"
 #include "PenAsMouse.h"
 #include "PenPicker.h"
 #include "Util.h"
+#include "VisibilityBuffer.h"
 #include "Writer.h"
 
 namespace mobamas {
 
-typedef std::vector<std::vector<int>> AdjacentList;
-
 const int kMouseLeftButtonCode = 0;
 const float kDisplayCanvasRatio = 1; // set < 1 to reduce canvas size
 const int kStampSize = 32; // on display
 const int kPenMoveThreshold = 5;
 const Polycode::Vector2 kInvalidPoint(-1, -1);
 
-static AdjacentList FindAdjacentFaces(Polycode::Mesh* mesh); 
-
 class PaintWorker {
 public:
 	PaintWorker(std::shared_ptr<Context> context, Polycode::Scene *scene, MeshGroup *mesh, PenPicker* picker);
@@ -41,17 +38,20 @@ private:
 	Polycode::Scene* scene_;
 	MeshGroup* mesh_;
 	Polycode::Vector2 last_pos_;
-	std::map<Polycode::Mesh*, AdjacentList> adjacent_faces_;
 	std::unique_ptr<PenPicker> picker_;
 	std::unique_ptr<cv::Mat> front_canvas_, back_canvas_;
+	cv::Rect front_dirty_rect_, back_dirty_rect_; // bounds of the strokes painted on each canvas
 	std::atomic_bool front_dirty_;
 	Polycode::Matrix4 camera_, projection_;
 	Polycode::Rectangle view_;
 	std::mutex m_dirty_textures_;
 	std::vector<Polycode::Texture*> dirty_textures_;
+	VisibilityBuffer visibility_; // of the pose and camera of the last WorkOff
 
 	bool PaintCanvas(Polycode::Vector2 const& last, Polycode::Vector2 const& next);
-	void PaintTexture(Polycode::Ray const& ray, Intersection const& intersection);
+	void MarkDirty(cv::Rect const& rect);
+	// triangles as ids of visibility_, of mesh
+	void PaintTexture(Polycode::SceneMesh* mesh, std::vector<int> const& triangles);
 };
 
 void WorkerThreadMainLoop(std::atomic_bool* interrupted, PaintWorker* worker) {
@@ -129,30 +129,37 @@ PaintWorker::PaintWorker(std::shared_ptr<Context> context, Polycode::Scene *scen
 	mesh_(mesh),
 	last_pos_(kInvalidPoint),
 	picker_(picker),
-	front_canvas_(new cv::Mat(kWinHeight * kDisplayCanvasRatio, kWinWidth * kDisplayCanvasRatio, CV_8UC4)),
-	back_canvas_(new cv::Mat(kWinHeight * kDisplayCanvasRatio, kWinWidth * kDisplayCanvasRatio, CV_8UC4)) {
-
-	for (auto mesh : mesh_->getSceneMeshes()) {
-		auto raw = mesh->getMesh();
-		adjacent_faces_[raw] = FindAdjacentFaces(raw);
-	}
+	// cleared only within the strokes afterwards
+	front_canvas_(new cv::Mat(kWinHeight * kDisplayCanvasRatio, kWinWidth * kDisplayCanvasRatio, CV_8UC4, cv::Scalar(0, 0, 0, 0))),
+	back_canvas_(new cv::Mat(kWinHeight * kDisplayCanvasRatio, kWinWidth * kDisplayCanvasRatio, CV_8UC4, cv::Scalar(0, 0, 0, 0))),
+	visibility_(kWinWidth * kDisplayCanvasRatio, kWinHeight * kDisplayCanvasRatio, kDisplayCanvasRatio) {
 }
 
 inline bool operator ==(const Polycode::Vector2 &a, const Polycode::Vector2 &b) {
 	return a.x == b.x && a.y == b.y;
 }
 
+void PaintWorker::MarkDirty(cv::Rect const& rect) {
+	auto clipped = rect & cv::Rect(cv::Point(0, 0), front_canvas_->size());
+	front_dirty_rect_ = front_dirty_rect_.area() == 0 ? clipped : (front_dirty_rect_ | clipped);
+}
+
 bool PaintWorker::PaintCanvas(Polycode::Vector2 const& last, Polycode::Vector2 const& next) {
 	switch (picker_->current_brush()) {
 	case Brush::PEN:
 	{
 		int cv_pen_size = PenPicker::DisplaySize(picker_->current_size()) * kDisplayCanvasRatio / 2;
+		auto to = ToCv<cv::Point>(next, kDisplayCanvasRatio);
 		if (last == kInvalidPoint) {
-			cv::circle(*front_canvas_, ToCv<cv::Point>(next, kDisplayCanvasRatio), cv_pen_size, ToCv(picker_->current_color()), -1);
+			cv::circle(*front_canvas_, to, cv_pen_size, ToCv(picker_->current_color()), -1);
+			MarkDirty(cv::Rect(to.x - cv_pen_size, to.y - cv_pen_size, cv_pen_size * 2 + 1, cv_pen_size * 2 + 1));
 			return true;
 		} else if (next.distance(last) > kPenMoveThreshold) {
-			cv::line(*front_canvas_, ToCv<cv::Point>(last, kDisplayCanvasRatio), ToCv<cv::Point>(next, kDisplayCanvasRatio),
-				ToCv(picker_->current_color()), cv_pen_size);
+			auto from = ToCv<cv::Point>(last, kDisplayCanvasRatio);
+			cv::line(*front_canvas_, from, to, ToCv(picker_->current_color()), cv_pen_size);
+			cv::Rect bounds(from, to);
+			MarkDirty(cv::Rect(bounds.x - cv_pen_size, bounds.y - cv_pen_size,
+				bounds.width + cv_pen_size * 2 + 1, bounds.height + cv_pen_size * 2 + 1));
 			return true;
 		}
 	}
@@ -191,6 +198,7 @@ bool PaintWorker::PaintCanvas(Polycode::Vector2 const& last, Polycode::Vector2 c
 			std::vector<cv::Mat> channels;
 			cv::split(src_roi, channels);
 			src_roi.copyTo(dest_roi, channels[3]);
+			MarkDirty(dest_rect);
 			return true;
 		}
 		break;
@@ -230,8 +238,7 @@ static void overlay(cv::Mat& texture, cv::Mat const& new_paint) {
 	}
 }
 
-void PaintWorker::PaintTexture(Polycode::Ray const& ray, Intersection const& intersection) {
-	auto mesh = intersection.scene_mesh;
+void PaintWorker::PaintTexture(Polycode::SceneMesh* mesh, std::vector<int> const& triangles) {
 	auto raw = mesh->getMesh();
 	assert(raw->getMeshType() == Polycode::Mesh::TRI_MESH);
 	auto texture = mesh->getTexture();
@@ -239,66 +246,32 @@ void PaintWorker::PaintTexture(Polycode::Ray const& ray, Intersection const& int
 	auto buffer = texture->getTextureData();
 	cv::Mat tex_mat(height, width, CV_8UC4, buffer);
 	cv::ocl::oclMat new_paint(height, width, CV_8UC4);
-	AdjacentList adjacent;
-	{
-		auto it = adjacent_faces_.find(raw);	
-		assert(it != adjacent_faces_.end() && "adjacent face is not registered for this mesh");
-		adjacent = it->second;
-	}
-
-	auto vertex_positions = ActualVertexPositions(mesh);
-
-	std::unordered_set<unsigned int> visited;
-	std::deque<unsigned int> waiting;
 	bool updated = false;
-	waiting.push_front(intersection.first_vertex_index);
-	auto renderer = Polycode::CoreServices::getInstance()->getRenderer();
-
-	while (!waiting.empty()) {
-		auto idx = waiting.front();
-		waiting.pop_front();
-		visited.insert(idx);
 
+	for (auto id : triangles) {
 		cv::Point2f screen[3];
-		float left, top, right, bottom;
-		for (size_t i = 0; i < 3; i++) {
-			auto v = vertex_positions[raw->indexArray.data[idx + i]];
-			screen[i] = ToCv<cv::Point2f>(renderer->Project(camera_, projection_, view_, v));
-			if (i == 0) {
-				left = right = screen[i].x;
-				top = bottom = screen[i].y;
-			} else {
-				if (screen[i].x < left)
-					left = screen[i].x;
-				if (screen[i].x > right)
-					right = screen[i].x;
-				if (screen[i].y < top)
-					top = screen[i].y;
-				if (screen[i].y > bottom)
-					bottom = screen[i].y;
-			}
+		visibility_.corners(id, screen);
+		float left = screen[0].x, top = screen[0].y, right = screen[0].x, bottom = screen[0].y;
+		for (size_t i = 1; i < 3; i++) {
+			left = std::min(left, screen[i].x);
+			right = std::max(right, screen[i].x);
+			top = std::min(top, screen[i].y);
+			bottom = std::max(bottom, screen[i].y);
 		}
-		cv::Mat mask(bottom - top + 1, right - left + 1, CV_8UC1, cv::Scalar(0));
-		cv::Point pts[3];
-		cv::Point2f zero_screen[3];
-		for (size_t i = 0; i < 3; i++) {
-			zero_screen[i] = cv::Point2f(screen[i].x - left, screen[i].y - top);
-			pts[i] = zero_screen[i];
-		}
-		const cv::Point *arr[1] = { pts };
-		int npts[] = { 3 };
-		cv::fillPoly(mask, arr, npts, 1, cv::Scalar(255));
-		cv::Rect mask_on_canvas(left, top, mask.cols, mask.rows);
-		cv::Rect inter = mask_on_canvas & cv::Rect(cv::Point(0, 0), back_canvas_->size());
-		cv::Mat mask_roi = mask((inter - cv::Point(left, top)) & cv::Rect(cv::Point(0, 0), mask.size()));
-		cv::Mat overlap;
-		(*back_canvas_)(inter).copyTo(overlap, mask_roi);
+		cv::Rect bounds(cv::Point(std::floor(left), std::floor(top)), cv::Point(std::ceil(right) + 1, std::ceil(bottom) + 1));
+		cv::Rect inter = bounds & cv::Rect(cv::Point(0, 0), back_canvas_->size());
+		// only the pixels where the triangle is in front
+		cv::Mat mask = visibility_.ids()(inter) == id;
+		cv::Mat overlap(inter.size(), back_canvas_->type(), cv::Scalar(0, 0, 0, 0));
+		(*back_canvas_)(inter).copyTo(overlap, mask);
 		if (!HasNonZero(overlap))
 			continue;
 
 		cv::ocl::oclMat g_overlap(overlap);
-		cv::Point2f tex[3];
+		int idx = visibility_.firstVertexIndex(id);
+		cv::Point2f zero_screen[3], tex[3];
 		for (size_t i = 0; i < 3; i++) {
+			zero_screen[i] = screen[i] - cv::Point2f(inter.x, inter.y);
 			auto uv = raw->getVertexTexCoordAtIndex(idx + i);
 			tex[i] = cv::Point2f(uv.x * width, uv.y * height);
 		}
@@ -309,17 +282,6 @@ void PaintWorker::PaintTexture(Polycode::Ray const& ray, Intersection const& int
 			overlay(tex_mat, cv::Mat(new_paint));
 			updated = true;
 		}
-
-		for (auto adj : adjacent[idx / 3]) {
-			auto v = raw->indexArray.data[adj];
-			Polycode::Vector3 local_normal(
-				raw->vertexNormalArray.data[v*3],
-				raw->vertexNormalArray.data[v*3+1],
-				raw->vertexNormalArray.data[v*3+2]);
-			auto normal = mesh->getConcatenatedMatrix() * local_normal;
-			if (visited.find(adj) == visited.end() && normal.dot(ray.direction) < 0)
-				waiting.push_front(adj);
-		}
 	}
 	if (updated) {
 		std::lock_guard<std::mutex> lock(m_dirty_textures_);
@@ -352,12 +314,29 @@ void PaintWorker::WorkOff() {
 		return;
 	}
 	std::swap(front_canvas_, back_canvas_);
-	auto ray = scene_->projectRayFromCameraAndViewportCoordinate(scene_->getActiveCamera(), last_pos_);
-	auto intersection = FindIntersectionPolygon(mesh_->getSceneMeshes(), ray);
-	if (intersection.found) {
-		PaintTexture(ray, intersection);
+	std::swap(front_dirty_rect_, back_dirty_rect_);
+	auto const& dirty = back_dirty_rect_;
+	visibility_.Update(mesh_, camera_, projection_, view_);
+	// the visible triangles under the stroke
+	std::map<Polycode::SceneMesh*, std::vector<int>> painted;
+	std::unordered_set<int> found;
+	auto const& ids = visibility_.ids();
+	for (int y = dirty.y; y < dirty.y + dirty.height; ++y) {
+		const uchar* ptr = back_canvas_->ptr<uchar>(y);
+		const int* id_ptr = ids.ptr<int>(y);
+		for (int x = dirty.x; x < dirty.x + dirty.width; ++x) {
+			if ((ptr[x * 4] | ptr[x * 4 + 1] | ptr[x * 4 + 2] | ptr[x * 4 + 3]) == 0)
+				continue;
+			int id = id_ptr[x];
+			if (id != VisibilityBuffer::kNoTriangle && found.insert(id).second)
+				painted[visibility_.mesh(id)].push_back(id);
+		}
+	}
+	for (auto const& p : painted) {
+		PaintTexture(p.first, p.second);
 	}
-	*back_canvas_ = cv::Scalar(0, 0, 0, 0);
+	(*back_canvas_)(dirty) = cv::Scalar(0, 0, 0, 0);
+	back_dirty_rect_ = cv::Rect();
 }
 
 void PaintWorker::UpdateOnMain() {
@@ -378,34 +357,4 @@ void PaintWorker::UpdateOnMain() {
 	}
 }
 
-AdjacentList FindAdjacentFaces(Polycode::Mesh* raw) {
-	size_t size = raw->indexArray.getDataSize();
-	AdjacentList list(size / 3);
-	for (size_t idx = 0; idx < size; idx += 3) {
-		auto v1 = raw->getVertexPositionAtIndex(idx),
-			v2 = raw->getVertexPositionAtIndex(idx + 1),
-			v3 = raw->getVertexPositionAtIndex(idx + 2);
-		for (size_t i = 0; i < size; i += 3) {
-			if (i == idx)
-				continue;
-			auto t1 = raw->getVertexPositionAtIndex(i),
-				t2 = raw->getVertexPositionAtIndex(i + 1),
-				t3 = raw->getVertexPositionAtIndex(i + 2);
-			if (v1 == t3 && v2 == t2 || v1 == t2 && v2 == t3
-				|| v1 == t3 && v3 == t2 || v1 == t2 && v3 == t3
-				|| v3 == t3 && v2 == t2 || v3 == t2 && v2 == t3
-				|| v1 == t1 && v2 == t3 || v1 == t3 && v2 == t1
-				|| v1 == t1 && v3 == t3 || v1 == t3 && v3 == t1
-				|| v3 == t1 && v2 == t3 || v3 == t3 && v2 == t1
-				|| v1 == t1 && v2 == t2 || v1 == t2 && v2 == t1
-				|| v1 == t1 && v3 == t2 || v1 == t2 && v3 == t1
-				|| v3 == t1 && v2 == t2 || v3 == t2 && v2 == t1) {
-
-				list[idx / 3].push_back(i);
-			}
-		}
-	}
-	return list;
-}
-
 }
\ No newline at end of file
@@ -9,7 +9,6 @@
 namespace mobamas {
 
 struct Context;
-struct Intersection;
 class MeshGroup;
 class PenAsMouse;
 class PenPicker;
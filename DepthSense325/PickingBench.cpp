@@ -0,0 +1,114 @@
+#include "PickingBench.h"
+
+#include <chrono>
+#include <random>
+
+#include "Import.h"
+#include "Intersection.h"
+
+namespace mobamas {
+
+const int kBenchRays = 1000;
+const double kBenchMissRatio = 0.2; // of rays in random directions, mostly missing
+const Polycode::Vector3 kBenchCamera(0, 0, 5); // as EditorApp
+
+static double ElapsedMs(std::chrono::high_resolution_clock::time_point since) {
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - since).count();
+}
+
+// The kernels test in float, so a ray through an edge may find the neighbor
+// triangle, or graze past it; such hits count as mismatches only if far apart.
+const double kSamePointDistance = 0.0001;
+
+static bool SamePoint(Intersection const& expected, Intersection const& actual) {
+	return expected.found == actual.found
+		&& (!expected.found || expected.point.distance(actual.point) < kSamePointDistance);
+}
+
+static void BenchPose(std::string const& name, char const* pose, MeshGroup* group, std::ostream& os) {
+	auto start = std::chrono::high_resolution_clock::now();
+	group->updateWorldVertices();
+	double update_ms = ElapsedMs(start);
+
+	std::vector<std::shared_ptr<const WorldVertices>> worlds;
+	size_t triangles = 0;
+	for (auto mesh : group->getSceneMeshes()) {
+		auto world = group->worldVertices(mesh);
+		if (!world || world->positions.empty())
+			continue;
+		worlds.push_back(world);
+		if (world->indices)
+			triangles += world->indices->size() / 3;
+	}
+	if (worlds.empty())
+		return;
+	// the first pick of a pose refits the hierarchies; timed apart from the rays
+	start = std::chrono::high_resolution_clock::now();
+	for (auto const& world : worlds)
+		world->bvhBoxes();
+	double refit_ms = ElapsedMs(start);
+
+	std::mt19937 random(0);
+	std::uniform_real_distribution<double> unit(-1, 1);
+	std::vector<Polycode::Ray> rays;
+	for (int i = 0; i < kBenchRays; i++) {
+		Polycode::Ray ray;
+		ray.origin = kBenchCamera;
+		if (i < kBenchRays * kBenchMissRatio) {
+			ray.direction = Polycode::Vector3(unit(random), unit(random), unit(random));
+		} else {
+			auto const& positions = worlds[random() % worlds.size()]->positions;
+			ray.direction = positions[random() % positions.size()] - ray.origin;
+		}
+		ray.direction.Normalize();
+		rays.push_back(ray);
+	}
+
+	double scalar_ms = 0, brute_ms = 0, bvh_ms = 0;
+	int hits = 0, brute_mismatches = 0, bvh_mismatches = 0;
+	for (auto const& ray : rays) {
+		start = std::chrono::high_resolution_clock::now();
+		auto expected = FindIntersectionPolygonScalar(group, ray);
+		scalar_ms += ElapsedMs(start);
+		start = std::chrono::high_resolution_clock::now();
+		auto brute = FindIntersectionPolygonBruteForce(group, ray);
+		brute_ms += ElapsedMs(start);
+		start = std::chrono::high_resolution_clock::now();
+		auto bvh = FindIntersectionPolygon(group, ray);
+		bvh_ms += ElapsedMs(start);
+		if (expected.found)
+			hits++;
+		if (!SamePoint(expected, brute))
+			brute_mismatches++;
+		if (!SamePoint(expected, bvh))
+			bvh_mismatches++;
+	}
+	os << "{\"model\": \"" << name << "\", \"pose\": \"" << pose << "\""
+		<< ", \"triangles\": " << triangles
+		<< ", \"rays\": " << rays.size()
+		<< ", \"hits\": " << hits
+		<< ", \"brute_force_mismatches\": " << brute_mismatches
+		<< ", \"bvh_mismatches\": " << bvh_mismatches
+		<< ", \"world_update_ms\": " << update_ms
+		<< ", \"refit_ms\": " << refit_ms
+		<< ", \"scalar_ms_per_ray\": " << scalar_ms / rays.size()
+		<< ", \"brute_force_ms_per_ray\": " << brute_ms / rays.size()
+		<< ", \"bvh_ms_per_ray\": " << bvh_ms / rays.size() << "}" << std::endl;
+}
+
+void BenchPicking(std::string const& name, MeshGroup* group, std::ostream& os) {
+	BenchPose(name, "loaded", group, os);
+	auto skeleton = group->getSkeleton();
+	if (!skeleton)
+		return;
+	// bend every bone a little, so that the boxes are refitted to a new pose
+	for (unsigned int i = 0; i < skeleton->getNumBones(); i++) {
+		auto bone = skeleton->getBone(i);
+		bone->Pitch(10);
+		bone->Yaw(10);
+	}
+	group->applyBoneMotion();
+	BenchPose(name, "bent", group, os);
+}
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+namespace mobamas {
+
+class MeshGroup;
+
+// Times FindIntersectionPolygon and FindIntersectionPolygonBruteForce against
+// FindIntersectionPolygonScalar on rays from the camera toward a group, in its
+// loaded pose and again after bending its bones, and counts the rays where they
+// find other points. Writes one JSON line per pose.
+// Start with "--bench-picking" to run it on every bundled model.
+void BenchPicking(std::string const& name, MeshGroup* group, std::ostream& os);
+
+}
@@ -1,29 +1,24 @@
 #include "Algorithms.h"
 
+#include <cassert>
 #include "Context.h"
 #include "DepthMap.h"
-#include "Recorder.h"
-#include "Util.h"
+#include "DepthMapUtil.h"
 
 namespace mobamas {
 
 const double kMinHoleSize = 60.0;
 
-static CvSeq* FindLargeHole(CvSeq *parent) {
-	auto hole = parent->v_next;
-	while (hole) {
-		if (cvContourArea(hole) > kMinHoleSize)
-			return hole;
-		hole = hole->h_next;
-	}
-	return NULL;
+Option<cv::Point3f> PinchCenterOfHole(std::shared_ptr<Context> context, const DepthMap& data) {
+	return PinchCenterOfHole(context, data, kMinHoleSize);
 }
 
-Option<cv::Point3f> PinchCenterOfHole(std::shared_ptr<Context> context, const DepthMap& data) {
+Option<cv::Point3f> PinchCenterOfHole(std::shared_ptr<Context> context, const DepthMap& data, double min_hole_size) {
 	assert(!data.binary.empty());
 	CvMemStorage *storage = cvCreateMemStorage(0);
 	CvSeq *cSeq = NULL;
-	cvFindContours(&((IplImage)data.binary), storage, &cSeq, sizeof(CvContour), CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE);
+	IplImage binary = data.binary;
+	cvFindContours(&binary, storage, &cSeq, sizeof(CvContour), CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE);
 
 	Option<cv::Point3f> found = Option<cv::Point3f>::None();
 	double max_area = 0;
@@ -31,7 +26,7 @@ Option<cv::Point3f> PinchCenterOfHole(std::shared_ptr<Context> context, const De
 		if (cvContourArea(cSeq) > max_area) {
 			found.Clear();
 			// hand with pinch hole
-			if (CvSeq* hole = FindLargeHole(cSeq)) {
+			if (CvSeq* hole = FindLargeHole(cSeq, min_hole_size)) {
 
 				CvMoments mu;
 				cvMoments(hole, &mu, false);
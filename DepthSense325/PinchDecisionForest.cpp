@@ -0,0 +1,133 @@
+#include "Algorithms.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include "Context.h"
+#include "DepthMap.h"
+#include "DepthMapUtil.h"
+#include "PinchForest.h"
+
+namespace mobamas {
+
+// Of the 33ms frame at 30fps; the rest is for the camera, tracker and rendering.
+const double kForestBudgetMs = 10.0;
+const int kCoarseStep = 4; // px between classified pixels of the first pass
+const float kContactProbability = 0.5f;
+const int kMinContactArea = 48; // px, to ignore isolated misclassification
+
+std::shared_ptr<const PinchForest> LoadPinchDetectionForest(std::string const& path) {
+	auto forest = std::make_shared<PinchForest>();
+	if (!LoadPinchForest(path, *forest)) {
+		std::cerr << "Failed to load pinch forest " << path << std::endl;
+		return nullptr;
+	}
+	return forest;
+}
+
+struct ContactSum {
+	int count;
+	double x, y, z;
+	int left, top, right, bottom;
+};
+
+static void AddContact(ContactSum& sum, DepthMap const& data, int x, int y) {
+	if (sum.count == 0) {
+		sum.left = sum.right = x;
+		sum.top = sum.bottom = y;
+	}
+	sum.count++;
+	sum.x += x;
+	sum.y += y;
+	sum.z += data.raw_mat.at<uint16_t>(y, x);
+	sum.left = std::min(sum.left, x);
+	sum.right = std::max(sum.right, x);
+	sum.top = std::min(sum.top, y);
+	sum.bottom = std::max(sum.bottom, y);
+}
+
+// Classify the hand pixels of row y at left, left + step, ... < right, 4 at a time.
+static void ClassifyRow(PinchForest const& forest, DepthMap const& data, int y, int left, int right, int step, ContactSum& sum) {
+	auto mask = data.binary.ptr<uchar>(y);
+	const float threshold = kContactProbability * forest.trees;
+	int xs[4];
+	float parts[4][kHandParts];
+	int n = 0;
+	auto flush = [&]() {
+		for (int l = n; l < 4; l++)
+			xs[l] = xs[n - 1]; // pad the last batch of the row
+		ClassifyPixels4(forest, data, xs, y, parts);
+		for (int l = 0; l < n; l++) {
+			if (parts[l][PinchContactPart] > threshold)
+				AddContact(sum, data, xs[l], y);
+		}
+		n = 0;
+	};
+	for (int x = left; x < right; x += step) {
+		if (!mask[x] || data.raw_mat.at<uint16_t>(y, x) == 0)
+			continue;
+		xs[n++] = x;
+		if (n == 4)
+			flush();
+	}
+	if (n > 0)
+		flush();
+}
+
+// Classify every step-th pixel of roi. Fails if the deadline passes.
+static bool ClassifyRegion(PinchForest const& forest, DepthMap const& data, cv::Rect const& roi, int step, int64 deadline, ContactSum& sum) {
+	sum.count = 0;
+	sum.x = sum.y = sum.z = 0;
+	for (int y = roi.y; y < roi.y + roi.height; y += step) {
+		if (cv::getTickCount() > deadline)
+			return false;
+		ClassifyRow(forest, data, y, roi.x, roi.x + roi.width, step, sum);
+	}
+	return true;
+}
+
+Option<cv::Point3f> PinchDecisionForest(std::shared_ptr<Context> context, const DepthMap& data) {
+	assert(!data.raw_mat.empty());
+	assert(!data.binary.empty());
+	Option<cv::Point3f> found = Option<cv::Point3f>::None();
+	auto forest = context ? context->pinch_forest : nullptr;
+	auto roi = HandBoundingBox(data.binary);
+	if (!forest || roi.area() == 0) {
+		DisplayPinchMats(data, found);
+		return found;
+	}
+
+	// Classify sparsely over the hand first, and then densely around the contact
+	// found if it fits in the rest of the budget. Gives up when over the budget,
+	// so that a frame never delays the next one.
+	int64 start = cv::getTickCount();
+	int64 deadline = start + static_cast<int64>(kForestBudgetMs * cv::getTickFrequency() / 1000);
+	ContactSum coarse;
+	if (!ClassifyRegion(*forest, data, roi, kCoarseStep, deadline, coarse)
+		|| coarse.count * kCoarseStep * kCoarseStep < kMinContactArea) {
+		DisplayPinchMats(data, found);
+		return found;
+	}
+	ContactSum contact = coarse;
+	cv::Rect fine_roi = cv::Rect(
+		cv::Point(coarse.left - kCoarseStep, coarse.top - kCoarseStep),
+		cv::Point(coarse.right + kCoarseStep + 1, coarse.bottom + kCoarseStep + 1)) & roi;
+	int64 now = cv::getTickCount();
+	double coarse_pixels = static_cast<double>(roi.area()) / (kCoarseStep * kCoarseStep);
+	double expected = (now - start) * fine_roi.area() / coarse_pixels;
+	ContactSum fine;
+	if (now + expected < deadline
+		&& ClassifyRegion(*forest, data, fine_roi, 1, deadline, fine)
+		&& fine.count >= kMinContactArea) {
+		contact = fine;
+	}
+
+	cv::Point pt(static_cast<int>(contact.x / contact.count + 0.5), static_cast<int>(contact.y / contact.count + 0.5));
+	found = ToPinchPoint(data, pt, static_cast<float>(contact.z / contact.count));
+
+	DisplayPinchMats(data, found);
+
+	return found;
+}
+
+}
@@ -0,0 +1,170 @@
+#include "Algorithms.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+#include "Context.h"
+#include "DepthMap.h"
+#include "DepthMapUtil.h"
+
+namespace mobamas {
+
+const int kMinHoleSize = 400; // same as PinchRightEdge to compare fairly
+const float kMedialTolerance = 1.0f;
+const float kInfDistance = 1e20f;
+
+const uchar kUnknown = 0;
+const uchar kHand = 1;
+const uchar kOutside = 2;
+const uchar kHole = 3;
+
+// 1D squared distance transform of sampled function f in linear time.
+// Felzenszwalb and Huttenlocher, "Distance Transforms of Sampled Functions", 2012.
+static void SquaredDistance1D(std::vector<float> const& f, int n, std::vector<float>& d, std::vector<int>& v, std::vector<float>& z) {
+	int k = 0;
+	v[0] = 0;
+	z[0] = -kInfDistance;
+	z[1] = kInfDistance;
+	for (int q = 1; q < n; q++) {
+		float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * (q - v[k]));
+		while (s <= z[k]) {
+			k--;
+			s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * (q - v[k]));
+		}
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = kInfDistance;
+	}
+	k = 0;
+	for (int q = 0; q < n; q++) {
+		while (z[k + 1] < q)
+			k++;
+		float dq = static_cast<float>(q - v[k]);
+		d[q] = dq * dq + f[v[k]];
+	}
+}
+
+// Squared euclidean distance from each pixel to the nearest pixel of the given class.
+static cv::Mat SquaredDistanceTransform(cv::Mat const& classes, uchar source) {
+	cv::Mat dist(classes.size(), CV_32FC1);
+	int n = std::max(classes.rows, classes.cols);
+	std::vector<float> f(n), d(n), z(n + 1);
+	std::vector<int> v(n);
+	for (int x = 0; x < classes.cols; x++) {
+		for (int y = 0; y < classes.rows; y++)
+			f[y] = classes.at<uchar>(y, x) == source ? 0 : kInfDistance;
+		SquaredDistance1D(f, classes.rows, d, v, z);
+		for (int y = 0; y < classes.rows; y++)
+			dist.at<float>(y, x) = d[y];
+	}
+	for (int y = 0; y < classes.rows; y++) {
+		auto row = dist.ptr<float>(y);
+		std::copy(row, row + classes.cols, f.begin());
+		SquaredDistance1D(f, classes.cols, d, v, z);
+		std::copy(d.begin(), d.begin() + classes.cols, row);
+	}
+	return dist;
+}
+
+// Fill unknown pixels 4-connected to seed with the class, and return the number of filled pixels.
+static int FloodFill(cv::Mat& classes, cv::Point seed, uchar value, std::vector<cv::Point>& queue) {
+	queue.clear();
+	classes.at<uchar>(seed) = value;
+	queue.push_back(seed);
+	for (size_t head = 0; head < queue.size(); head++) {
+		auto p = queue[head];
+		const cv::Point neighbors[] = { cv::Point(p.x - 1, p.y), cv::Point(p.x + 1, p.y), cv::Point(p.x, p.y - 1), cv::Point(p.x, p.y + 1) };
+		for (auto const& n : neighbors) {
+			if (n.x < 0 || n.y < 0 || n.x >= classes.cols || n.y >= classes.rows)
+				continue;
+			if (classes.at<uchar>(n) == kUnknown) {
+				classes.at<uchar>(n) = value;
+				queue.push_back(n);
+			}
+		}
+	}
+	return static_cast<int>(queue.size());
+}
+
+// Classify pixels in the hand bounding box (with 1px background margin) into hand,
+// outside background and the largest enclosed hole. Returns false if no hole is large enough.
+static bool ClassifyHandAndHole(cv::Mat const& binary, cv::Rect const& roi, cv::Mat& classes) {
+	classes = cv::Mat(roi.height + 2, roi.width + 2, CV_8UC1, cv::Scalar(kUnknown));
+	for (int y = 0; y < roi.height; y++) {
+		auto src = binary.ptr<uchar>(roi.y + y) + roi.x;
+		auto dst = classes.ptr<uchar>(y + 1) + 1;
+		for (int x = 0; x < roi.width; x++) {
+			if (src[x])
+				dst[x] = kHand;
+		}
+	}
+	std::vector<cv::Point> queue;
+	queue.reserve(classes.total());
+	FloodFill(classes, cv::Point(0, 0), kOutside, queue);
+
+	// remaining unknown pixels are enclosed by the hand
+	std::vector<cv::Point> largest;
+	for (int y = 0; y < classes.rows; y++) {
+		for (int x = 0; x < classes.cols; x++) {
+			if (classes.at<uchar>(y, x) != kUnknown)
+				continue;
+			int area = FloodFill(classes, cv::Point(x, y), kHand, queue); // small holes are noise
+			if (area > kMinHoleSize && area > static_cast<int>(largest.size()))
+				largest.swap(queue);
+		}
+	}
+	for (auto const& p : largest)
+		classes.at<uchar>(p) = kHole;
+	return !largest.empty();
+}
+
+Option<cv::Point3f> PinchDistanceTransform(std::shared_ptr<Context> context, const DepthMap& data) {
+	assert(!data.raw_mat.empty());
+	assert(!data.binary.empty());
+	Option<cv::Point3f> found = Option<cv::Point3f>::None();
+
+	auto roi = HandBoundingBox(data.binary);
+	cv::Mat classes;
+	if (roi.area() == 0 || !ClassifyHandAndHole(data.binary, roi, classes)) {
+		DisplayPinchMats(data, found);
+		return found;
+	}
+
+	// The ring of hand around the hole is thinnest where thumb and index finger touch.
+	// Its medial line is equidistant from the hole and the outside, and ring width there
+	// is the sum of both distances.
+	auto to_outside = SquaredDistanceTransform(classes, kOutside);
+	auto to_hole = SquaredDistanceTransform(classes, kHole);
+	float min_width = FLT_MAX;
+	cv::Point bridge(-1, -1);
+	for (int y = 0; y < classes.rows; y++) {
+		auto cls = classes.ptr<uchar>(y);
+		auto dout = to_outside.ptr<float>(y);
+		auto dhole = to_hole.ptr<float>(y);
+		for (int x = 0; x < classes.cols; x++) {
+			if (cls[x] != kHand)
+				continue;
+			float a = std::sqrt(dout[x]), b = std::sqrt(dhole[x]);
+			if (std::fabs(a - b) <= kMedialTolerance && a + b < min_width) {
+				min_width = a + b;
+				bridge = cv::Point(x, y);
+			}
+		}
+	}
+	if (bridge.x < 0) {
+		DisplayPinchMats(data, found);
+		return found;
+	}
+
+	cv::Point pt = bridge + roi.tl() - cv::Point(1, 1);
+	found = ToPinchPoint(data, pt, DepthAtOrLeftOf(data, pt));
+
+	DisplayPinchMats(data, found);
+
+	return found;
+}
+
+}
@@ -0,0 +1,53 @@
+#include "PinchEventQueue.h"
+
+namespace mobamas {
+
+void PinchEventQueue::Push(PinchEventType type, cv::Point3f const& point) {
+	size_t tail = tail_.load(std::memory_order_relaxed);
+	size_t free = kPinchEventQueueCapacity - (tail - head_.load(std::memory_order_acquire));
+	// A start needs room for its end, and moves leave room for an end and the next start.
+	switch (type) {
+	case PinchStartEvent:
+		dropping_ = free < 2;
+		break;
+	case PinchMoveEvent:
+		if (free <= 2)
+			return;
+		break;
+	case PinchEndEvent:
+		if (dropping_) {
+			dropping_ = false;
+			return;
+		}
+		break;
+	}
+	if (dropping_)
+		return;
+	auto& e = events_[tail % kPinchEventQueueCapacity];
+	e.type = type;
+	e.point = point;
+	tail_.store(tail + 1, std::memory_order_release);
+}
+
+void PinchEventQueue::Drain(PinchEventListener& listener) {
+	size_t head = head_.load(std::memory_order_relaxed);
+	size_t tail = tail_.load(std::memory_order_acquire);
+	for (; head != tail; head++) {
+		auto e = events_[head % kPinchEventQueueCapacity];
+		switch (e.type) {
+		case PinchStartEvent:
+			listener.OnPinchStart(e.point);
+			break;
+		case PinchMoveEvent:
+			if (head + 1 == tail || events_[(head + 1) % kPinchEventQueueCapacity].type != PinchMoveEvent)
+				listener.OnPinchMove(e.point);
+			break;
+		case PinchEndEvent:
+			listener.OnPinchEnd();
+			break;
+		}
+	}
+	head_.store(head, std::memory_order_release);
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <opencv2/opencv.hpp>
+
+#include "CameraEventListeners.h"
+
+namespace mobamas {
+
+enum PinchEventType {
+	PinchStartEvent,
+	PinchMoveEvent,
+	PinchEndEvent,
+};
+
+struct PinchEvent {
+	PinchEventType type;
+	cv::Point3f point; // unused for PinchEndEvent
+};
+
+const size_t kPinchEventQueueCapacity = 64; // power of two
+
+// Hands pinch events from the sensor thread to the render thread without locks.
+// The sensor thread (single producer) calls the listener methods, and the render
+// thread (single consumer) delivers the queued events by Drain. When the render
+// thread stalls and the queue is full, moves are dropped first, and a pinch is
+// dropped as a whole rather than losing its end.
+class PinchEventQueue : public PinchEventListener {
+public:
+	PinchEventQueue() : head_(0), tail_(0), dropping_(false) {}
+
+	void OnPinchStart(cv::Point3f point) override { Push(PinchStartEvent, point); }
+	void OnPinchMove(cv::Point3f point) override { Push(PinchMoveEvent, point); }
+	void OnPinchEnd() override { Push(PinchEndEvent, cv::Point3f()); }
+
+	// Deliver the queued events in order. Consecutive moves are coalesced into
+	// the last one, so that the model is deformed at most once per move run.
+	void Drain(PinchEventListener& listener);
+
+private:
+	PinchEvent events_[kPinchEventQueueCapacity];
+	std::atomic<size_t> head_; // next to read, written by the consumer
+	std::atomic<size_t> tail_; // next to write, written by the producer
+	bool dropping_; // the start of the current pinch was dropped, producer only
+
+	void Push(PinchEventType type, cv::Point3f const& point);
+};
+
+}
@@ -0,0 +1,217 @@
+#include "PinchFilter.h"
+
+#include <cassert>
+#include <cmath>
+#include <deque>
+
+namespace mobamas {
+
+const double kPi = 3.14159265358979323846;
+const double kDefaultFrameInterval = 1.0 / 30; // when the corpus has no timestamps
+// x and y are ratios to the window; scale z (mm) to the similar magnitude to share parameters.
+const double kDepthScale = 1e-3;
+
+PinchFilterParams PinchFilterParamsFor(OperationMode mode) {
+	PinchFilterParams params;
+	params.type = MovingAveragePinchFilter; // mouse and touch, as BoneManipulation used to average them
+	params.lead_time = 0.05;
+	params.window = 6;
+	params.min_cutoff = 1.0;
+	params.beta = 20.0;
+	params.d_cutoff = 4.0; // high enough for the velocity to follow, as it is extrapolated
+	params.process_noise = 10.0;
+	params.measurement_noise = 2.5e-5; // about 0.5% of the window
+	switch (mode) {
+	case MidAirMode:
+		params.type = OneEuroPinchFilter;
+		break;
+	case FrontMode:
+		params.type = KalmanPinchFilter;
+		break;
+	default:
+		break;
+	}
+	return params;
+}
+
+static cv::Vec3d ToState(cv::Point3f const& point) {
+	return cv::Vec3d(point.x, point.y, point.z * kDepthScale);
+}
+
+static cv::Point3f FromState(cv::Vec3d const& state) {
+	return cv::Point3f(
+		static_cast<float>(state[0]),
+		static_cast<float>(state[1]),
+		static_cast<float>(state[2] / kDepthScale));
+}
+
+static double Interval(double prev, double now) {
+	if (prev == 0 && now == 0)
+		return kDefaultFrameInterval;
+	return now - prev;
+}
+
+class PassThrough : public PinchFilter {
+public:
+	PassThrough() : PinchFilter(0), last_(0, 0, 0) {}
+	void Reset(cv::Point3f const& point, double timestamp) override { last_ = point; }
+	void Update(cv::Point3f const& point, double timestamp) override { last_ = point; }
+
+protected:
+	cv::Point3f Extrapolate(double time) const override { return last_; }
+
+private:
+	cv::Point3f last_;
+};
+
+class MovingAverage : public PinchFilter {
+public:
+	explicit MovingAverage(int window) : PinchFilter(0), window_(window) {}
+	void Reset(cv::Point3f const& point, double timestamp) override {
+		points_.assign(window_, point);
+	}
+	void Update(cv::Point3f const& point, double timestamp) override {
+		points_.push_back(point);
+		points_.pop_front();
+	}
+
+protected:
+	cv::Point3f Extrapolate(double time) const override {
+		cv::Point3f sum;
+		for (auto const& p : points_)
+			sum += p;
+		return sum * (1.0f / points_.size());
+	}
+
+private:
+	int window_;
+	std::deque<cv::Point3f> points_;
+};
+
+// Low pass filter whose cutoff rises with the speed, so that slow moves are
+// smooth and fast moves lag little. The derivative is also used for extrapolation.
+class OneEuro : public PinchFilter {
+public:
+	explicit OneEuro(PinchFilterParams const& params) :
+		PinchFilter(params.lead_time),
+		min_cutoff_(params.min_cutoff), beta_(params.beta), d_cutoff_(params.d_cutoff),
+		last_time_(0) {}
+
+	void Reset(cv::Point3f const& point, double timestamp) override {
+		x_ = ToState(point);
+		dx_ = cv::Vec3d();
+		last_time_ = timestamp;
+	}
+
+	void Update(cv::Point3f const& point, double timestamp) override {
+		double dt = Interval(last_time_, timestamp);
+		if (dt <= 0)
+			return; // same frame again
+		last_time_ = timestamp;
+		auto x = ToState(point);
+		double a_d = Alpha(d_cutoff_, dt);
+		for (int i = 0; i < 3; i++) {
+			dx_[i] += a_d * ((x[i] - x_[i]) / dt - dx_[i]);
+			double cutoff = min_cutoff_ + beta_ * fabs(dx_[i]);
+			x_[i] += Alpha(cutoff, dt) * (x[i] - x_[i]);
+		}
+	}
+
+protected:
+	cv::Point3f Extrapolate(double time) const override {
+		return FromState(x_ + dx_ * (time - last_time_));
+	}
+
+private:
+	double min_cutoff_, beta_, d_cutoff_;
+	cv::Vec3d x_, dx_;
+	double last_time_;
+
+	static double Alpha(double cutoff, double dt) {
+		double tau = 1.0 / (2 * kPi * cutoff);
+		return 1.0 / (1.0 + tau / dt);
+	}
+};
+
+// Independent constant velocity Kalman filter for each axis, with
+// piecewise white noise acceleration of the given spectral density.
+class ConstantVelocityKalman : public PinchFilter {
+public:
+	explicit ConstantVelocityKalman(PinchFilterParams const& params) :
+		PinchFilter(params.lead_time),
+		q_(params.process_noise), r_(params.measurement_noise),
+		last_time_(0) {}
+
+	void Reset(cv::Point3f const& point, double timestamp) override {
+		auto x = ToState(point);
+		for (int i = 0; i < 3; i++) {
+			axes_[i].p = x[i];
+			axes_[i].v = 0;
+			axes_[i].pp = r_;
+			axes_[i].pv = 0;
+			axes_[i].vv = q_ * kDefaultFrameInterval; // unknown velocity at start
+		}
+		last_time_ = timestamp;
+	}
+
+	void Update(cv::Point3f const& point, double timestamp) override {
+		double dt = Interval(last_time_, timestamp);
+		if (dt <= 0)
+			return;
+		last_time_ = timestamp;
+		auto x = ToState(point);
+		for (int i = 0; i < 3; i++) {
+			auto& a = axes_[i];
+			// predict
+			a.p += a.v * dt;
+			a.pp += dt * (2 * a.pv + dt * a.vv) + q_ * dt * dt * dt / 3;
+			a.pv += dt * a.vv + q_ * dt * dt / 2;
+			a.vv += q_ * dt;
+			// correct
+			double s = a.pp + r_;
+			double kp = a.pp / s, kv = a.pv / s;
+			double residual = x[i] - a.p;
+			a.p += kp * residual;
+			a.v += kv * residual;
+			a.vv -= kv * a.pv;
+			a.pv -= kv * a.pp;
+			a.pp -= kp * a.pp;
+		}
+	}
+
+protected:
+	cv::Point3f Extrapolate(double time) const override {
+		double dt = time - last_time_;
+		cv::Vec3d x;
+		for (int i = 0; i < 3; i++)
+			x[i] = axes_[i].p + axes_[i].v * dt;
+		return FromState(x);
+	}
+
+private:
+	struct Axis {
+		double p, v; // state
+		double pp, pv, vv; // covariance
+	};
+	double q_, r_;
+	Axis axes_[3];
+	double last_time_;
+};
+
+std::unique_ptr<PinchFilter> CreatePinchFilter(PinchFilterParams const& params) {
+	switch (params.type) {
+	case NoPinchFilter:
+		return std::unique_ptr<PinchFilter>(new PassThrough());
+	case MovingAveragePinchFilter:
+		return std::unique_ptr<PinchFilter>(new MovingAverage(params.window));
+	case OneEuroPinchFilter:
+		return std::unique_ptr<PinchFilter>(new OneEuro(params));
+	case KalmanPinchFilter:
+		return std::unique_ptr<PinchFilter>(new ConstantVelocityKalman(params));
+	default:
+		assert(false && "unspecified pinch filter type");
+		return nullptr;
+	}
+}
+
+}
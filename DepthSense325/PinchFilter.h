@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <opencv2/opencv.hpp>
+
+#include "Context.h"
+
+namespace mobamas {
+
+enum PinchFilterType {
+	NoPinchFilter,
+	MovingAveragePinchFilter, // averages the last samples, which BoneManipulation used to do
+	OneEuroPinchFilter,
+	KalmanPinchFilter, // constant velocity model
+};
+
+struct PinchFilterParams {
+	PinchFilterType type;
+	double lead_time; // sec; extrapolate this far ahead of the capture time to compensate display latency
+	int window; // MovingAverage
+	double min_cutoff, beta, d_cutoff; // OneEuro, Casiez et al. CHI 2012
+	double process_noise, measurement_noise; // Kalman
+};
+
+// Tuned per operation mode; replay with PinchBench --replay to adjust.
+PinchFilterParams PinchFilterParamsFor(OperationMode mode);
+
+// Smooths pinch positions between PinchTracker and the listener.
+// Timestamps are capture times of the depth frames in seconds.
+class PinchFilter {
+public:
+	explicit PinchFilter(double lead_time) : lead_time_(lead_time) {}
+	virtual ~PinchFilter() {}
+
+	virtual void Reset(cv::Point3f const& point, double timestamp) = 0;
+	virtual void Update(cv::Point3f const& point, double timestamp) = 0;
+	// Position expected when the frame captured at the timestamp is displayed.
+	cv::Point3f Predict(double timestamp) const { return Extrapolate(timestamp + lead_time_); }
+
+protected:
+	virtual cv::Point3f Extrapolate(double time) const = 0;
+
+private:
+	double lead_time_;
+};
+
+std::unique_ptr<PinchFilter> CreatePinchFilter(PinchFilterParams const& params);
+
+}
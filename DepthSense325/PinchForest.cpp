@@ -0,0 +1,124 @@
+#include "PinchForest.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MOBAMAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace mobamas {
+
+bool SavePinchForest(std::string const& path, PinchForest const& forest) {
+	cv::FileStorage fs(path, cv::FileStorage::WRITE);
+	if (!fs.isOpened())
+		return false;
+	cv::Mat splits(static_cast<int>(forest.splits.size()), 5, CV_16SC1);
+	for (size_t i = 0; i < forest.splits.size(); i++) {
+		auto const& s = forest.splits[i];
+		auto row = splits.ptr<int16_t>(static_cast<int>(i));
+		row[0] = s.ux; row[1] = s.uy; row[2] = s.vx; row[3] = s.vy; row[4] = s.threshold;
+	}
+	cv::Mat leaves(static_cast<int>(forest.leaves.size() / kHandParts), kHandParts, CV_32FC1);
+	std::memcpy(leaves.data, forest.leaves.data(), forest.leaves.size() * sizeof(float));
+	fs << "trees" << forest.trees << "depth" << forest.depth
+		<< "splits" << splits << "leaves" << leaves;
+	return true;
+}
+
+bool LoadPinchForest(std::string const& path, PinchForest& forest) {
+	cv::FileStorage fs(path, cv::FileStorage::READ);
+	if (!fs.isOpened())
+		return false;
+	forest.trees = static_cast<int>(fs["trees"]);
+	forest.depth = static_cast<int>(fs["depth"]);
+	cv::Mat splits, leaves;
+	fs["splits"] >> splits;
+	fs["leaves"] >> leaves;
+	if (forest.trees <= 0 || forest.depth <= 0
+		|| splits.rows != forest.trees * forest.SplitsPerTree() || splits.cols != 5 || splits.type() != CV_16SC1
+		|| leaves.rows != forest.trees * forest.LeavesPerTree() || leaves.cols != kHandParts || leaves.type() != CV_32FC1)
+		return false;
+	forest.splits.resize(splits.rows);
+	for (int i = 0; i < splits.rows; i++) {
+		auto row = splits.ptr<int16_t>(i);
+		ForestSplit s = { row[0], row[1], row[2], row[3], row[4] };
+		forest.splits[i] = s;
+	}
+	forest.leaves.assign(leaves.ptr<float>(0), leaves.ptr<float>(0) + leaves.total());
+	return true;
+}
+
+void ClassifyPixel(PinchForest const& forest, DepthMap const& map, int x, int y, float* parts) {
+	for (int p = 0; p < kHandParts; p++)
+		parts[p] = 0;
+	float scale = kOffsetScale / static_cast<float>(ProbeDepth(map, x, y));
+	for (int t = 0; t < forest.trees; t++) {
+		auto splits = forest.TreeSplits(t);
+		int node = 0;
+		for (int level = 0; level < forest.depth; level++) {
+			auto const& split = splits[node];
+			node = 2 * node + (SplitFeature(map, x, y, scale, split) > split.threshold ? 2 : 1);
+		}
+		auto leaf = forest.Leaf(t, node - forest.SplitsPerTree());
+		for (int p = 0; p < kHandParts; p++)
+			parts[p] += leaf[p];
+	}
+}
+
+#ifdef MOBAMAS_SSE2
+void ClassifyPixels4(PinchForest const& forest, DepthMap const& map, int const* xs, int y, float (*parts)[kHandParts]) {
+	std::memset(parts, 0, sizeof(float) * 4 * kHandParts);
+	int depths[4];
+	for (int l = 0; l < 4; l++)
+		depths[l] = ProbeDepth(map, xs[l], y);
+	const __m128 scale = _mm_div_ps(_mm_set1_ps(static_cast<float>(kOffsetScale)),
+		_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(depths))));
+	const __m128 px = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(xs)));
+	const __m128 py = _mm_set1_ps(static_cast<float>(y));
+	const __m128i one = _mm_set1_epi32(1);
+
+	for (int t = 0; t < forest.trees; t++) {
+		auto splits = forest.TreeSplits(t);
+		__m128i node = _mm_setzero_si128();
+		for (int level = 0; level < forest.depth; level++) {
+			int idx[4], thresholds[4];
+			float ux[4], uy[4], vx[4], vy[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(idx), node);
+			for (int l = 0; l < 4; l++) {
+				auto const& s = splits[idx[l]];
+				ux[l] = s.ux; uy[l] = s.uy; vx[l] = s.vx; vy[l] = s.vy;
+				thresholds[l] = s.threshold;
+			}
+			// probe coordinates of the 4 pixels at once
+			int ax[4], ay[4], bx[4], by[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(ax), _mm_cvttps_epi32(_mm_add_ps(px, _mm_mul_ps(_mm_loadu_ps(ux), scale))));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(ay), _mm_cvttps_epi32(_mm_add_ps(py, _mm_mul_ps(_mm_loadu_ps(uy), scale))));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(bx), _mm_cvttps_epi32(_mm_add_ps(px, _mm_mul_ps(_mm_loadu_ps(vx), scale))));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(by), _mm_cvttps_epi32(_mm_add_ps(py, _mm_mul_ps(_mm_loadu_ps(vy), scale))));
+			int features[4];
+			for (int l = 0; l < 4; l++)
+				features[l] = ProbeDepth(map, ax[l], ay[l]) - ProbeDepth(map, bx[l], by[l]);
+			// node = 2 node + 1, and + 1 more where the feature is over the threshold
+			__m128i right = _mm_cmpgt_epi32(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(features)),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(thresholds)));
+			node = _mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(node, node), one), right);
+		}
+		int idx[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(idx), node);
+		for (int l = 0; l < 4; l++) {
+			auto leaf = forest.Leaf(t, idx[l] - forest.SplitsPerTree());
+			for (int p = 0; p < kHandParts; p++)
+				parts[l][p] += leaf[p];
+		}
+	}
+}
+#else
+void ClassifyPixels4(PinchForest const& forest, DepthMap const& map, int const* xs, int y, float (*parts)[kHandParts]) {
+	for (int l = 0; l < 4; l++)
+		ClassifyPixel(forest, map, xs[l], y, parts[l]);
+}
+#endif
+
+}
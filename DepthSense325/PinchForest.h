@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "DepthMap.h"
+
+namespace mobamas {
+
+// Per-pixel classification of the hand into parts by a randomized decision forest
+// on depth difference features (Shotton et al., CVPR 2011). Trained offline by
+// PinchForestTrainer from a pinch corpus; used by PinchDecisionForest.
+
+enum HandPart {
+	PinchContactPart, // where thumb and index finger touch
+	FingerPart,
+	PalmPart,
+};
+const int kHandParts = 3;
+
+const int kOffsetScale = 1000; // offsets are in px at 1m (1000mm), divided by depth
+const int kBackgroundDepth = 10000; // mm, probe outside of the hand
+
+// Internal node of a tree; goes right if depth(x + u) - depth(x + v) > threshold.
+struct ForestSplit {
+	int16_t ux, uy, vx, vy; // px at 1m
+	int16_t threshold; // mm
+};
+
+// Trees are complete binary trees of the same depth, so nodes are stored in flat
+// arrays in breadth-first order without child pointers: children of node i are
+// 2i+1 and 2i+2. Leaves hold the probability of each part.
+struct PinchForest {
+	int trees;
+	int depth;
+	std::vector<ForestSplit> splits; // trees * (2^depth - 1)
+	std::vector<float> leaves; // trees * 2^depth * kHandParts
+
+	int SplitsPerTree() const { return (1 << depth) - 1; }
+	int LeavesPerTree() const { return 1 << depth; }
+	ForestSplit const* TreeSplits(int tree) const { return &splits[tree * SplitsPerTree()]; }
+	float const* Leaf(int tree, int leaf) const { return &leaves[(tree * LeavesPerTree() + leaf) * kHandParts]; }
+};
+
+bool SavePinchForest(std::string const& path, PinchForest const& forest);
+bool LoadPinchForest(std::string const& path, PinchForest& forest);
+
+inline int ProbeDepth(DepthMap const& map, int x, int y) {
+	if (x < 0 || y < 0 || x >= map.binary.cols || y >= map.binary.rows || !map.binary.at<uchar>(y, x))
+		return kBackgroundDepth;
+	int depth = map.raw_mat.at<uint16_t>(y, x);
+	return depth > 0 ? depth : kBackgroundDepth;
+}
+
+// scale is kOffsetScale / depth of the pixel itself. Computed in float in the same
+// order as the SSE2 path, so that training and detection agree.
+inline int SplitFeature(DepthMap const& map, int x, int y, float scale, ForestSplit const& split) {
+	return ProbeDepth(map, static_cast<int>(x + split.ux * scale), static_cast<int>(y + split.uy * scale))
+		- ProbeDepth(map, static_cast<int>(x + split.vx * scale), static_cast<int>(y + split.vy * scale));
+}
+
+// Sum of part probabilities over all trees for a hand pixel.
+void ClassifyPixel(PinchForest const& forest, DepthMap const& map, int x, int y, float* parts);
+// Same for 4 hand pixels of row y at xs[0..3], parts[4][kHandParts].
+// Traverses the trees in lockstep with SSE2 where available.
+void ClassifyPixels4(PinchForest const& forest, DepthMap const& map, int const* xs, int y, float (*parts)[kHandParts]);
+
+}
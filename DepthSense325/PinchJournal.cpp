@@ -0,0 +1,51 @@
+#include "PinchJournal.h"
+
+#include <cstring>
+
+namespace mobamas {
+
+bool PinchJournalWriter::Open(std::wstring const& path, Models model, OperationMode mode) {
+	out_.open(path, std::ios::out | std::ios::binary);
+	if (!out_.is_open())
+		return false;
+	PinchJournalHeader header;
+	std::memcpy(header.magic, kPinchJournalMagic, sizeof(header.magic));
+	header.version = kPinchJournalVersion;
+	header.model = model;
+	header.operation_mode = mode;
+	out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	start_ = std::chrono::steady_clock::now();
+	return true;
+}
+
+void PinchJournalWriter::Write(PinchEventType type, cv::Point3f const& point) {
+	if (!out_.is_open())
+		return;
+	PinchJournalRecord record;
+	record.type = type;
+	record.x = point.x;
+	record.y = point.y;
+	record.z = point.z;
+	record.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+	out_.write(reinterpret_cast<const char*>(&record), sizeof(record));
+	if (type != PinchMoveEvent)
+		out_.flush(); // keep whole pinches if the app is killed
+}
+
+bool ReadPinchJournal(std::string const& path, PinchJournalHeader& header, std::vector<PinchJournalRecord>& records) {
+	std::ifstream in(path, std::ios::in | std::ios::binary);
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+		|| std::memcmp(header.magic, kPinchJournalMagic, sizeof(header.magic)) != 0
+		|| header.version != kPinchJournalVersion)
+		return false;
+	records.clear();
+	PinchJournalRecord record;
+	while (in.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+		if (record.type > PinchEndEvent)
+			return false;
+		records.push_back(record);
+	}
+	return true;
+}
+
+}
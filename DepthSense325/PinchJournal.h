@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "Context.h"
+#include "Models.h"
+#include "PinchEventQueue.h"
+
+namespace mobamas {
+
+// Binary journal of the pinch events given to BoneManipulation, to replay the
+// manipulation of a session (see PinchReplay). Little endian, as written on x86.
+
+const char kPinchJournalMagic[4] = { 'M', 'P', 'J', 'L' };
+const uint32_t kPinchJournalVersion = 1;
+
+struct PinchJournalHeader {
+	char magic[4];
+	uint32_t version;
+	int32_t model;
+	int32_t operation_mode;
+};
+
+struct PinchJournalRecord {
+	uint32_t type; // PinchEventType
+	float x, y, z;
+	double time; // sec since the journal was opened
+};
+static_assert(sizeof(PinchJournalRecord) == 24, "journal records must be packed");
+
+class PinchJournalWriter {
+public:
+	PinchJournalWriter() {}
+	bool Open(std::wstring const& path, Models model, OperationMode mode);
+	void Write(PinchEventType type, cv::Point3f const& point);
+
+private:
+	std::ofstream out_;
+	std::chrono::steady_clock::time_point start_;
+};
+
+bool ReadPinchJournal(std::string const& path, PinchJournalHeader& header, std::vector<PinchJournalRecord>& records);
+
+}
@@ -0,0 +1,127 @@
+#include "Algorithms.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <vector>
+#include "Context.h"
+#include "DepthMap.h"
+#include "DepthMapUtil.h"
+
+namespace mobamas {
+
+const double kMinHoleSize = 400.0; // at full resolution, same as PinchRightEdge
+
+// Each coarse pixel is set when the majority of its factor x factor block is set.
+// Ties are background so that pinch holes do not close up.
+static cv::Mat Downsample(cv::Mat const& binary, int factor) {
+	cv::Mat coarse(binary.rows / factor, binary.cols / factor, CV_8UC1);
+	std::vector<int> counts(coarse.cols);
+	int threshold = factor * factor / 2;
+	for (int cy = 0; cy < coarse.rows; cy++) {
+		std::fill(counts.begin(), counts.end(), 0);
+		for (int y = cy * factor; y < (cy + 1) * factor; y++) {
+			auto src = binary.ptr<uchar>(y);
+			for (int x = 0, width = coarse.cols * factor; x < width; x++) {
+				if (src[x])
+					counts[x / factor]++;
+			}
+		}
+		auto dst = coarse.ptr<uchar>(cy);
+		for (int cx = 0; cx < coarse.cols; cx++) {
+			dst[cx] = counts[cx] > threshold ? 0xff : 0;
+		}
+	}
+	return coarse;
+}
+
+struct Candidate {
+	cv::Point point; // right most hand point beside the hole
+	int hole_min_y, hole_max_y;
+};
+
+// Same as PinchRightEdge, on the coarse mask.
+static Option<Candidate> FindCoarseCandidate(cv::Mat& coarse, double min_hole_size) {
+	CvMemStorage *storage = cvCreateMemStorage(0);
+	CvSeq *cSeq = NULL;
+	IplImage ipl = coarse;
+	cvFindContours(&ipl, storage, &cSeq, sizeof(CvContour), CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE);
+
+	Option<Candidate> found = Option<Candidate>::None();
+	while (cSeq != NULL) {
+		if (cvContourArea(cSeq) > 0) {
+			found.Clear();
+			if (CvSeq* hole = FindLargeHole(cSeq, min_hole_size)) {
+				CvSeqReader reader;
+				cvStartReadSeq(hole, &reader, 0);
+				Candidate c;
+				c.hole_min_y = INT_MAX;
+				c.hole_max_y = 0;
+				for (int i = 0; i < hole->total; i++) {
+					cv::Point pt;
+					CV_READ_SEQ_ELEM(pt, reader);
+					if (pt.y > c.hole_max_y) c.hole_max_y = pt.y;
+					if (pt.y < c.hole_min_y) c.hole_min_y = pt.y;
+				}
+				cvStartReadSeq(cSeq, &reader, 0);
+				c.point = cv::Point(-1, -1);
+				for (int i = 0; i < cSeq->total; i++) {
+					cv::Point pt;
+					CV_READ_SEQ_ELEM(pt, reader);
+					if (c.point.x < pt.x && pt.y >= c.hole_min_y && pt.y <= c.hole_max_y)
+						c.point = pt;
+				}
+				if (c.point.x >= 0)
+					found.Reset(c);
+			}
+		}
+		cSeq = cSeq->h_next;
+	}
+	cvReleaseMemStorage(&storage);
+	return found;
+}
+
+Option<cv::Point3f> PinchRightEdgePyramid(std::shared_ptr<Context> context, const DepthMap& data, int factor) {
+	assert(!data.raw_mat.empty());
+	assert(!data.binary.empty());
+	assert(factor >= 1);
+	Option<cv::Point3f> found = Option<cv::Point3f>::None();
+
+	auto coarse = Downsample(data.binary, factor);
+	auto candidate = FindCoarseCandidate(coarse, kMinHoleSize / (factor * factor));
+	if (!candidate) {
+		DisplayPinchMats(data, found);
+		return found;
+	}
+
+	// Refine in the rows of the hole, within one coarse pixel around the candidate.
+	auto c = *candidate;
+	cv::Rect window(
+		(c.point.x - 1) * factor,
+		c.hole_min_y * factor,
+		3 * factor,
+		(c.hole_max_y - c.hole_min_y + 1) * factor);
+	window &= cv::Rect(0, 0, data.binary.cols, data.binary.rows);
+	cv::Point right_most_point(-1, 0);
+	for (int y = window.y; y < window.y + window.height; y++) {
+		auto ptr = data.binary.ptr<uchar>(y);
+		for (int x = window.x + window.width - 1; x >= window.x && x > right_most_point.x; x--) {
+			if (ptr[x]) {
+				right_most_point.x = x;
+				right_most_point.y = y;
+				break;
+			}
+		}
+	}
+	if (right_most_point.x < 0) {
+		DisplayPinchMats(data, found);
+		return found;
+	}
+	found = ToPinchPoint(data, right_most_point, DepthAtOrLeftOf(data, right_most_point));
+
+	DisplayPinchMats(data, found);
+
+	return found;
+}
+
+}
@@ -0,0 +1,87 @@
+#include "PinchReplay.h"
+
+#include <algorithm>
+
+#include "BoneManipulation.h"
+
+namespace mobamas {
+
+PinchReplay::PinchReplay(std::string const& path) : path_(path), next_(0) {
+	PinchJournalHeader header;
+	loaded_ = ReadPinchJournal(path, header, records_);
+}
+
+static double TicksToMs(int64 ticks) {
+	return ticks * 1000.0 / cv::getTickFrequency();
+}
+
+bool PinchReplay::Step(BoneManipulation& manipulation) {
+	if (next_ >= records_.size())
+		return false;
+	auto const& record = records_[next_++];
+	cv::Point3f point(record.x, record.y, record.z);
+	auto before = manipulation.timings();
+	switch (record.type) {
+	case PinchStartEvent:
+		manipulation.OnPinchStart(point);
+		break;
+	case PinchMoveEvent:
+		manipulation.OnPinchMove(point);
+		break;
+	case PinchEndEvent:
+		manipulation.OnPinchEnd();
+		break;
+	}
+	manipulation.Update();
+	auto after = manipulation.timings();
+	Sample sample;
+	sample.type = static_cast<PinchEventType>(record.type);
+	sample.rotate = TicksToMs(after.rotate - before.rotate);
+	sample.skinning = TicksToMs(after.skinning - before.skinning);
+	sample.handles = TicksToMs(after.handles - before.handles);
+	samples_.push_back(sample);
+	return true;
+}
+
+static void WriteStats(std::ostream& os, std::vector<double> values) {
+	std::sort(values.begin(), values.end());
+	double total = 0;
+	for (auto v : values)
+		total += v;
+	auto at = [&](double p) {
+		return values.empty() ? 0 : values[std::min(values.size() - 1, static_cast<size_t>(p * (values.size() - 1) + 0.5))];
+	};
+	os << "{\"mean\": " << (values.empty() ? 0 : total / values.size())
+		<< ", \"p50\": " << at(0.5)
+		<< ", \"p99\": " << at(0.99)
+		<< ", \"max\": " << (values.empty() ? 0 : values.back())
+		<< ", \"total\": " << total << "}";
+}
+
+void PinchReplay::WriteReport(std::ostream& os) const {
+	const char* names[] = { "start", "move", "end" };
+	os << "{\"journal\": \"" << path_ << "\""
+		<< ", \"events\": " << samples_.size()
+		<< ", \"types\": [" << std::endl;
+	for (int type = PinchStartEvent; type <= PinchEndEvent; type++) {
+		std::vector<double> rotate, skinning, handles;
+		for (auto const& s : samples_) {
+			if (s.type != type)
+				continue;
+			rotate.push_back(s.rotate);
+			skinning.push_back(s.skinning);
+			handles.push_back(s.handles);
+		}
+		os << "    {\"type\": \"" << names[type] << "\", \"count\": " << rotate.size()
+			<< ", \"rotate_ms\": ";
+		WriteStats(os, rotate);
+		os << ", \"skinning_ms\": ";
+		WriteStats(os, skinning);
+		os << ", \"handles_ms\": ";
+		WriteStats(os, handles);
+		os << "}" << (type < PinchEndEvent ? "," : "") << std::endl;
+	}
+	os << "]}" << std::endl;
+}
+
+}
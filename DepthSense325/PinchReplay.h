@@ -0,0 +1,38 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "PinchJournal.h"
+
+namespace mobamas {
+
+class BoneManipulation;
+
+// Replays a pinch journal into BoneManipulation, one event per step regardless of
+// the recorded timing so that runs are comparable, and reports the time spent in
+// each part of the manipulation per event. Start with "--replay journal_path", which
+// runs ReplayPinchJournal (EditorApp.h).
+class PinchReplay {
+public:
+	explicit PinchReplay(std::string const& path);
+	bool loaded() const { return loaded_; }
+	// Deliver the next event and update the handles. Returns false when all are done.
+	bool Step(BoneManipulation& manipulation);
+	// JSON, in ms per event for each event type.
+	void WriteReport(std::ostream& os) const;
+
+private:
+	struct Sample {
+		PinchEventType type;
+		double rotate, skinning, handles; // ms
+	};
+	std::string path_;
+	bool loaded_;
+	std::vector<PinchJournalRecord> records_;
+	size_t next_;
+	std::vector<Sample> samples_;
+};
+
+}
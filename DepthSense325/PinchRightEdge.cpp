@@ -1,9 +1,10 @@
 #include "Algorithms.h"
 
+#include <cassert>
+#include <cfloat>
 #include "Context.h"
 #include "DepthMap.h"
-#include "Recorder.h"
-#include "Util.h"
+#include "DepthMapUtil.h"
 
 namespace mobamas {
 
@@ -19,31 +20,25 @@ static bool HasHandHole(CvSeq *parent) {
 	return false;
 }
 
-static CvSeq* FindLargeHole(CvSeq *parent) {
-	auto hole = parent->v_next;
-	while (hole) {
-		if (cvContourArea(hole) > kMinHoleSize)
-			return hole;
-		hole = hole->h_next;
-	}
-	return NULL;
+Option<cv::Point3f> PinchRightEdge(std::shared_ptr<Context> context, const DepthMap& data) {
+	return PinchRightEdge(context, data, kMinHoleSize);
 }
 
-Option<cv::Point3f> PinchRightEdge(std::shared_ptr<Context> context, const DepthMap& data) {
+Option<cv::Point3f> PinchRightEdge(std::shared_ptr<Context> context, const DepthMap& data, double min_hole_size) {
 	assert(!data.raw_mat.empty());
 	assert(!data.binary.empty());
 	CvMemStorage *storage = cvCreateMemStorage(0);
 	CvSeq *cSeq = NULL;
-	cvFindContours(&((IplImage)data.binary), storage, &cSeq, sizeof(CvContour), CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE);
+	IplImage binary = data.binary;
+	cvFindContours(&binary, storage, &cSeq, sizeof(CvContour), CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE);
 
 	Option<cv::Point3f> found = Option<cv::Point3f>::None();
 	double max_area = 0;
-	cv::Point center(data.offset.x + data.w / 2, data.offset.y + data.h / 2);
 	while (cSeq != NULL) {
 		if (cvContourArea(cSeq) > max_area) {
 			found.Clear();
 			// hand with pinch hole
-			if (CvSeq* hole = FindLargeHole(cSeq)) {
+			if (CvSeq* hole = FindLargeHole(cSeq, min_hole_size)) {
 				CvSeqReader reader;
 				cvStartReadSeq(hole, &reader, 0);
 				double max_y = 0;
@@ -69,13 +64,7 @@ Option<cv::Point3f> PinchRightEdge(std::shared_ptr<Context> context, const Depth
 						}
 					}
 				}
-				float rx = (right_most_point.x - center.x) / static_cast<float>(data.w);
-				float ry = (right_most_point.y - center.y) / static_cast<float>(data.h);
-				if (rx >= -0.5 && rx <= 0.5 && ry >= -0.5 && ry <= 0.5)
-					found.Reset(cv::Point3f(
-						0.5 + rx,
-						0.5 + ry,
-						right_most_point.z));
+				found = ToPinchPoint(data, cv::Point2f(right_most_point.x, right_most_point.y), right_most_point.z);
 			}
 		}
 		cSeq = cSeq->h_next;
@@ -0,0 +1,231 @@
+#include "Algorithms.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include "Context.h"
+#include "DepthMap.h"
+#include "DepthMapUtil.h"
+
+namespace mobamas {
+
+const double kMinHoleSize = 400.0; // same as PinchRightEdge
+const int kBand = 12; // px the hole and the right edge may move between frames
+const double kMinAreaRatio = 0.5;
+const double kMaxAreaRatio = 2.0;
+
+// Moore neighborhood in clockwise order, y downwards.
+const cv::Point kNeighbors[8] = {
+	cv::Point(1, 0), cv::Point(1, 1), cv::Point(0, 1), cv::Point(-1, 1),
+	cv::Point(-1, 0), cv::Point(-1, -1), cv::Point(0, -1), cv::Point(1, -1),
+};
+
+static int DirectionOf(cv::Point const& d) {
+	for (int i = 0; i < 8; i++) {
+		if (kNeighbors[i] == d)
+			return i;
+	}
+	assert(false && "not a neighbor");
+	return 0;
+}
+
+struct HoleBoundary {
+	double area; // signed, positive for a hole enclosed by the hand
+	int perimeter;
+	int min_y, max_y;
+	cv::Point start; // background pixel where the trace started
+};
+
+static bool IsHand(cv::Mat const& binary, cv::Point const& p) {
+	return binary.at<uchar>(p) != 0;
+}
+
+// Trace the background component containing seed along its border with the hand by
+// Moore neighbor tracing, until the first step repeats. Cost is proportional to the
+// perimeter. Fails if the component reaches the image border or is too long.
+static bool TraceHole(cv::Mat const& binary, cv::Point seed, int max_perimeter, HoleBoundary& boundary) {
+	if (IsHand(binary, seed))
+		return false;
+	auto start = seed;
+	while (start.x + 1 < binary.cols && !IsHand(binary, start + kNeighbors[0]))
+		start.x++;
+	if (start.x + 1 >= binary.cols)
+		return false;
+
+	auto p = start;
+	int back = 0; // east of start is hand
+	cv::Point second(-1, -1);
+	double twice_area = 0;
+	boundary.min_y = boundary.max_y = start.y;
+	boundary.perimeter = 0;
+	while (true) {
+		int dir = -1;
+		for (int k = 1; k <= 8; k++) {
+			int d = (back + k) % 8;
+			auto n = p + kNeighbors[d];
+			if (n.x <= 0 || n.y <= 0 || n.x >= binary.cols - 1 || n.y >= binary.rows - 1)
+				return false; // open to the outside of the image
+			if (!IsHand(binary, n)) {
+				dir = d;
+				break;
+			}
+		}
+		if (dir < 0)
+			return false; // single pixel
+		auto next = p + kNeighbors[dir];
+		if (p == start) {
+			if (next == second)
+				break;
+			if (second.x < 0)
+				second = next;
+		}
+		back = DirectionOf(p + kNeighbors[(dir + 7) % 8] - next);
+		twice_area += p.x * next.y - next.x * p.y;
+		p = next;
+		if (p.y < boundary.min_y) boundary.min_y = p.y;
+		if (p.y > boundary.max_y) boundary.max_y = p.y;
+		if (++boundary.perimeter > max_perimeter)
+			return false;
+	}
+
+	boundary.area = twice_area / 2;
+	boundary.start = start;
+	return true;
+}
+
+// Middle of the run of background pixels in the row of p, which is in the background.
+// Unlike the centroid of the boundary, it stays inside holes which are not convex.
+static cv::Point CenterOfRun(cv::Mat const& binary, cv::Point const& p) {
+	auto ptr = binary.ptr<uchar>(p.y);
+	int left = p.x, right = p.x;
+	while (left > 0 && !ptr[left - 1])
+		left--;
+	while (right + 1 < binary.cols && !ptr[right + 1])
+		right++;
+	return cv::Point((left + right) / 2, p.y);
+}
+
+// Background pixel inside the hole contour, in its middle row.
+static bool SeedOf(cv::Mat const& binary, CvSeq* hole, cv::Point& seed) {
+	cv::Rect box = cvBoundingRect(hole, 0);
+	int y = box.y + box.height / 2;
+	for (int x = box.x; x < box.x + box.width; x++) {
+		cv::Point p(x, y);
+		if (!IsHand(binary, p) && cvPointPolygonTest(hole, cvPoint2D32f(x, y), 0) > 0) {
+			seed = CenterOfRun(binary, p);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Right most hand pixel in the rows of the hole, scanning leftwards from limit_x.
+// Fails if the hand reaches limit_x, i.e. the edge moved further than expected.
+static bool FindRightEdge(cv::Mat const& binary, int min_y, int max_y, int limit_x, cv::Point& right_most) {
+	right_most = cv::Point(-1, -1);
+	limit_x = std::min(limit_x, binary.cols - 1);
+	for (int y = min_y; y <= max_y; y++) {
+		auto ptr = binary.ptr<uchar>(y);
+		if (ptr[limit_x])
+			return false;
+		for (int x = limit_x - 1; x > right_most.x; x--) {
+			if (ptr[x]) {
+				right_most = cv::Point(x, y);
+				break;
+			}
+		}
+	}
+	return right_most.x >= 0;
+}
+
+static Option<cv::Point3f> ToPinchPoint(DepthMap const& data, cv::Point const& pt) {
+	return ToPinchPoint(data, pt, DepthAtOrLeftOf(data, pt));
+}
+
+// Update the hole from the last frame, only looking around its boundary.
+static bool UpdateTrack(HoleTrack& track, DepthMap const& data, Option<cv::Point3f>& found) {
+	HoleBoundary boundary;
+	if (!TraceHole(data.binary, track.seed, track.perimeter * 2 + 8 * kBand, boundary))
+		return false;
+	// a loop around the whole hand has the opposite orientation
+	if (boundary.area < kMinHoleSize
+		|| boundary.area < track.area * kMinAreaRatio
+		|| boundary.area > track.area * kMaxAreaRatio)
+		return false;
+	cv::Point right_most;
+	if (!FindRightEdge(data.binary, boundary.min_y, boundary.max_y, track.right_x + kBand, right_most))
+		return false;
+
+	track.seed = CenterOfRun(data.binary, boundary.start);
+	track.area = boundary.area;
+	track.perimeter = boundary.perimeter;
+	track.right_x = right_most.x;
+	found = ToPinchPoint(data, right_most);
+	return true;
+}
+
+// Same as PinchRightEdge, and starts tracking the hole found.
+static Option<cv::Point3f> DetectAndStartTrack(HoleTrack& track, DepthMap const& data) {
+	// keep the binary image intact to trace in the next frames
+	cv::Mat copy = data.binary.clone();
+	CvMemStorage *storage = cvCreateMemStorage(0);
+	CvSeq *cSeq = NULL;
+	IplImage binary = copy;
+	cvFindContours(&binary, storage, &cSeq, sizeof(CvContour), CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE);
+
+	Option<cv::Point3f> found = Option<cv::Point3f>::None();
+	track.tracking = false;
+	while (cSeq != NULL) {
+		if (cvContourArea(cSeq) > 0) {
+			found.Clear();
+			track.tracking = false;
+			if (CvSeq* hole = FindLargeHole(cSeq, kMinHoleSize)) {
+				CvSeqReader reader;
+				cvStartReadSeq(hole, &reader, 0);
+				double max_y = 0;
+				double min_y = DBL_MAX;
+				for (int i = 0; i < hole->total; i++) {
+					cv::Point pt;
+					CV_READ_SEQ_ELEM(pt, reader);
+					if (pt.y > max_y) max_y = pt.y;
+					if (pt.y < min_y) min_y = pt.y;
+				}
+				cvStartReadSeq(cSeq, &reader, 0);
+				cv::Point right_most(0, 0);
+				for (int i = 0; i < cSeq->total; i++) {
+					cv::Point pt;
+					CV_READ_SEQ_ELEM(pt, reader);
+					if (right_most.x < pt.x && pt.y >= min_y && pt.y <= max_y)
+						right_most = pt;
+				}
+				found = ToPinchPoint(data, right_most);
+
+				track.area = std::fabs(cvContourArea(hole));
+				track.perimeter = static_cast<int>(cvArcLength(hole, CV_WHOLE_SEQ, 1)) + 1;
+				track.right_x = right_most.x;
+				track.tracking = SeedOf(data.binary, hole, track.seed);
+			}
+		}
+		cSeq = cSeq->h_next;
+	}
+	cvReleaseMemStorage(&storage);
+	return found;
+}
+
+Option<cv::Point3f> PinchRightEdgeTracking(std::shared_ptr<Context> context, const DepthMap& data) {
+	assert(context && context->hole_track);
+	assert(!data.raw_mat.empty());
+	assert(!data.binary.empty());
+	auto& track = *context->hole_track;
+	Option<cv::Point3f> found = Option<cv::Point3f>::None();
+
+	if (!track.tracking || !UpdateTrack(track, data, found))
+		found = DetectAndStartTrack(track, data);
+
+	DisplayPinchMats(data, found);
+
+	return found;
+}
+
+}
@@ -1,61 +1,74 @@
 #include "PinchTracker.h"
 
+#include <algorithm>
+#include <cmath>
 #include "CameraEventListeners.h"
 #include "Context.h"
 #include "DepthMap.h"
 
 namespace mobamas {
 
-	void PinchTracker::NotifyNewData(Option<cv::Point3f> const& data) {
+	const int kConfidentStartFrames = 2;
+	const float kMinConfidence = 0.5f;
+	const float kMaxCoherentMove = 0.05f;
+
+	PinchTrackerParams PinchTrackerParamsFor(int window) {
+		PinchTrackerParams params;
+		params.start_frames = window;
+		params.confident_start_frames = std::min(kConfidentStartFrames, window);
+		params.end_frames = std::max(1, window - 1);
+		params.min_confidence = kMinConfidence;
+		params.max_coherent_move = kMaxCoherentMove;
+		return params;
+	}
+
+	PinchTracker::PinchTracker(std::shared_ptr<Context> context, PinchTrackerParams const& params) :
+		context_(context),
+		params_(params),
+		hits_(0),
+		confident_hits_(0),
+		misses_(0),
+		last_(Option<cv::Point3f>::None()),
+		pinching_(false),
+		filter_(CreatePinchFilter(PinchFilterParamsFor(context->operation_mode))) {}
+
+	float PinchTracker::Confidence(cv::Point3f const& point) const {
+		if (!last_)
+			return 0;
+		float dx = point.x - (*last_).x, dy = point.y - (*last_).y;
+		return std::max(0.0f, 1 - sqrtf(dx * dx + dy * dy) / params_.max_coherent_move);
+	}
+
+	void PinchTracker::NotifyNewData(Option<cv::Point3f> const& data, double timestamp) {
 		auto listener = context_->pinch_listeners.lock();
 		if (!listener)
 			return;
-		Push(data);
+		if (data) {
+			hits_++;
+			misses_ = 0;
+			// the first detection of a coherent run counts as well
+			confident_hits_ = Confidence(*data) >= params_.min_confidence ? confident_hits_ + 1 : 1;
+		}
+		else {
+			hits_ = confident_hits_ = 0;
+			misses_++;
+		}
+		last_ = data;
+
 		if (pinching_) {
-			auto point = Pop();
-			if (point) {
-				listener->OnPinchMove(*point);
+			if (data) {
+				filter_->Update(*data, timestamp);
+				listener->OnPinchMove(filter_->Predict(timestamp));
 			}
-			else {
+			else if (misses_ >= params_.end_frames) {
 				pinching_ = false;
 				listener->OnPinchEnd();
 			}
 		}
-		else {
-			auto point = PopDense();
-			if (point) {
-				pinching_ = true;
-				listener->OnPinchStart(*point);
-			}
-		}
-
-	}
-	
-	Option<cv::Point3f> PinchTracker::Pop(){
-		auto it = prev_.begin();
-		*it++;
-		while (it != prev_.end()) {
-			if (*it) return *it;
-			*it++;
-		}
-		return Option<cv::Point3f>::None();
-	}
-
-	
-
-	void PinchTracker::Push(Option<cv::Point3f> point) {
-		prev_.push_back(point);
-		if (prev_.size() > 6) {
-			prev_.pop_front();
-		}
-	}
-
-	Option<cv::Point3f> PinchTracker::PopDense() {
-		auto it = prev_.begin();
-		int count = 0;
-		while (it != prev_.end()) {
-			if (!*it++) return Option<cv::Point3f>::None();
+		else if (hits_ >= params_.start_frames || confident_hits_ >= params_.confident_start_frames) {
+			pinching_ = true;
+			filter_->Reset(*data, timestamp);
+			listener->OnPinchStart(*data);
 		}
-		return prev_.back();
 	}
-}
\ No newline at end of file
+}
@@ -1,29 +1,54 @@
 #pragma once
 
-#include <opencv2\opencv.hpp>
+#include <opencv2/opencv.hpp>
 #include <memory>
 #include "Option.h"
+#include "PinchFilter.h"
 
 namespace mobamas {
 
 struct Context;
 struct DepthMap;
 
+const int kDefaultTrackerWindow = 6; // frames
+
+// Debounce of the detections. A pinch starts after start_frames consecutive
+// detections, or confident_start_frames if all of them are confident, and ends
+// after end_frames consecutive misses. No move is sent for a miss, so the pinch
+// stays where it was over shorter dropouts. Detectors give no score, so a detection
+// is confident as much as it agrees with the one in the previous frame, down to
+// 0 at a move of max_coherent_move (x,y are ratios to the window).
+struct PinchTrackerParams {
+	int start_frames;
+	int confident_start_frames;
+	int end_frames;
+	float min_confidence; // 0.0 - 1.0
+	float max_coherent_move;
+};
+
+// Same debounce as the former window of window frames, with confident start.
+PinchTrackerParams PinchTrackerParamsFor(int window);
+
 class PinchTracker {
 public:
-	explicit PinchTracker(std::shared_ptr<Context> context) :
-		context_(context), 
-		prev_(std::deque<Option<cv::Point3f>>()),
-		pinching_(false) {}
-	void NotifyNewData(Option<cv::Point3f> const& data);
+	explicit PinchTracker(std::shared_ptr<Context> context, int window = kDefaultTrackerWindow) :
+		PinchTracker(context, PinchTrackerParamsFor(window)) {}
+	PinchTracker(std::shared_ptr<Context> context, PinchTrackerParams const& params);
+	// timestamp is the capture time of the frame in seconds
+	void NotifyNewData(Option<cv::Point3f> const& data, double timestamp);
+	void set_filter(std::unique_ptr<PinchFilter> filter) { filter_ = std::move(filter); }
 
 private:
 	std::shared_ptr<Context> context_;
-	std::deque<Option<cv::Point3f>> prev_;
+	PinchTrackerParams params_;
+	// lengths of the current runs of detections and misses
+	int hits_;
+	int confident_hits_;
+	int misses_;
+	Option<cv::Point3f> last_;
 	bool pinching_;
-	Option<cv::Point3f> Pop();
-	void Push(Option<cv::Point3f> point);
-	Option<cv::Point3f> PopDense();
+	std::unique_ptr<PinchFilter> filter_;
+	float Confidence(cv::Point3f const& point) const;
 };
 
 }
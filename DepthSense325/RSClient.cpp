@@ -8,7 +8,9 @@
 #include "Algorithms.h"
 #include "Context.h"
 #include "DepthMap.h"
+#include "DepthMapUtil.h"
 #include "Util.h"
+#include "Writer.h"
 
 namespace mobamas {
 
@@ -65,7 +67,8 @@ bool RSClient::Prepare() {
 
 	auto input = Polycode::CoreServices::getInstance()->getInput();
 	using Polycode::InputEvent;
-	if (context_->operation_mode == OperationMode::FrontMode) {
+	// the corpus toggle and the calibration keys, in the modes pinching with the camera
+	if (context_->operation_mode == OperationMode::MidAirMode || context_->operation_mode == OperationMode::FrontMode) {
 		input->addEventListener(this, InputEvent::EVENT_KEYDOWN);
 		input->addEventListener(this, InputEvent::EVENT_KEYUP);
 	}
@@ -103,6 +106,14 @@ void RSClient::handleEvent(Polycode::Event *e) {
 	{
 		auto ie = (InputEvent*)e;
 		auto key = ie->getKey();
+		if (key == Polycode::PolyKEY::KEY_r) {
+			recording_corpus_ = !recording_corpus_;
+			std::cout << "Pinch corpus recording " << (recording_corpus_ ? "started" : "stopped") << std::endl;
+			break;
+		}
+		// calibration keys for frontal origin
+		if (context_->operation_mode != OperationMode::FrontMode)
+			break;
 		switch (key) {
 			case Polycode::PolyKEY::KEY_z:
 			{
@@ -232,52 +243,6 @@ static cv::Mat ConvertDepthImage(PXCCapture::Sample* sample) {
 	return mat;
 }
 
-static void ReplaceFrontalOrigin(cv::Mat& raw_depth, cv::Mat& seg_mask, cv::Point& offset, uint16_t saturated, float kX, float kY, float kYOffset, uint16_t kZFar) {
-	assert(!raw_depth.empty());
-	assert(raw_depth.size() == seg_mask.size());
-	int cx = raw_depth.cols / 2, cy = raw_depth.rows / 2;
-	offset = cv::Point(raw_depth.cols / 2, raw_depth.rows / 2);
-
-	cv::Mat new_depth(raw_depth.rows * 2, raw_depth.cols * 2, raw_depth.type());
-	cv::Point max(new_depth.cols - offset.x - 1, new_depth.rows - offset.y - 1);
-	cv::Mat new_mask(new_depth.rows, new_depth.cols, seg_mask.type());
-	new_depth = saturated;
-	new_mask = 0;
-	for (size_t y = 0; y < raw_depth.rows - 1; y++) {
-		for (size_t x = 0; x < raw_depth.cols - 1; x++) {
-			auto z = raw_depth.at<uint16_t>(y, x);
-			auto z2 = raw_depth.at<uint16_t>(y+1, x+1);
-			if (z == saturated || z2 == saturated)
-				continue;
-			cv::Point ps(cx + kX * (static_cast<int>(x) - cx) * z, cy + kY * (static_cast<int>(y) - cy) * z - kYOffset * raw_depth.rows);
-			cv::Point pe(cx + kX * (static_cast<int>(x)+1 - cx) * z2, cy + kY * (static_cast<int>(y)+1 - cy) * z2 - kYOffset * raw_depth.rows);
-			if (pe.x < -offset.x || pe.y < -offset.y
-				|| ps.x > max.x || ps.y > max.y
-				|| ps.x > pe.x || ps.y > pe.y)
-				continue;
-			for (int ix = std::max(ps.x, -offset.x); ix <= std::min(pe.x, max.x); ++ix) {
-				for (int iy = std::max(ps.y, -offset.y); iy <= std::min(pe.y, max.y); ++iy) {
-					new_depth.at<uint16_t>(iy + offset.y, ix + offset.x) = std::max(kZFar - z, 0);
-					new_mask.at<uint8_t>(iy + offset.y, ix + offset.x) = seg_mask.at<uint8_t>(y, x);
-				}
-			}
-		}
-	}
-	raw_depth = new_depth;
-	seg_mask = new_mask;
-}
-
-static uint16_t GetMinimumApplicableValue(cv::Mat depth) {
-	assert(!depth.empty());
-	uint16_t min = 0xffff;
-	for (size_t i = 0, length = depth.total(); i < length; i++)
-	{
-		auto v = depth.at<uint16_t>(i);
-		if (min > v && v > 0) min = v;
-	}
-	return min;
-}
-
 static DepthMap CreateDepthMap(PXCCapture::Sample* sample, cv::Mat const& raw_depth, cv::Mat const& binary, cv::Point const& offset, uint16_t saturated) {
 	auto depth = sample->depth;
 	auto info = depth->QueryInfo();	
@@ -309,7 +274,8 @@ static DepthMap CreateDepthMap(PXCCapture::Sample* sample, cv::Mat const& raw_de
 		raw_depth,
 		norm,
 		binary,
-		offset
+		offset,
+		depth->QueryTimeStamp() * 1e-7 // in 100ns
 	};
 }
 
@@ -330,6 +296,9 @@ void RSClient::Run() {
 	min_values.reserve(kCalibrationFrames);
 	uint16_t min_depth_threshold = 350; // good default value for front facing setting
 	int iter_count = 0;
+	context_->hole_track = std::make_shared<HoleTrack>(); // frames of this run only
+	if (context_->pinch_detector == DecisionForestDetector && !context_->pinch_forest)
+		context_->pinch_forest = LoadPinchDetectionForest();
 
 	while (!should_quit_ && sm_ != nullptr && (error = sm_->AcquireFrame(true)) >= PXC_STATUS_NO_ERROR) {
 		error = blob_data->Update();
@@ -344,6 +313,14 @@ void RSClient::Run() {
 		if (seg_mask.empty()) {
 			seg_mask = cv::Mat(raw_depth.size(), CV_8UC1, cv::Scalar(0));
 		}
+		// camera images before preprocessing, to tune its parameters offline
+		bool recording = recording_corpus_;
+		DepthSource source;
+		if (recording) {
+			source.operation_mode = context_->operation_mode;
+			source.depth = raw_depth.clone();
+			source.mask = seg_mask.clone();
+		}
 		if (context_->operation_mode == OperationMode::FrontMode) {
 			ReplaceFrontalOrigin(raw_depth, seg_mask, offset, saturated, kX, kY, kYOffset, kZFar);
 		}
@@ -389,8 +366,21 @@ void RSClient::Run() {
 				last_depth_map_ = depth_map;
 			}
 
-			auto result = PinchRightEdge(context_, depth_map);
-			tracker_.NotifyNewData(result);
+			// cvFindContours overwrites the binary image, so keep the original for the corpus
+			DepthMap sample;
+			if (recording) {
+				sample = depth_map;
+				sample.raw_mat = depth_map.raw_mat.clone();
+				sample.binary = depth_map.binary.clone();
+			}
+
+			auto result = SelectPinchAlgorithm(context_->pinch_detector)(context_, depth_map);
+			tracker_.NotifyNewData(result, depth_map.timestamp);
+
+			if (recording) {
+				// detected point is the initial label; fix it by hand afterwards
+				context_->writer->WritePinchSample(sample, result, source);
+			}
 		}
 
 		iter_count++;
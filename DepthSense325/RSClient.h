@@ -27,6 +27,7 @@ public:
 
 private:
 	volatile bool should_quit_ = false;
+	volatile bool recording_corpus_ = false;
 	std::shared_ptr<Context> context_;
 	PinchTracker tracker_;
 	PXCSenseManager *sm_;
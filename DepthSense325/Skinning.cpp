@@ -0,0 +1,253 @@
+#include "Skinning.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MOBAMAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace mobamas {
+
+const float kMinNormalLength = 1e-08f; // as Polycode::Vector3::Normalize
+
+// Quantizes the weights over 0 of a vertex to sum up to kWeightScale. Returns the
+// number of influences left.
+static int QuantizeWeights(float const* weights, float const* bone_ids, uint16_t* qweights, uint16_t* qbones) {
+	float total = 0;
+	for (int k = 0; k < kMaxInfluences; k++) {
+		if (weights[k] > 0)
+			total += weights[k];
+	}
+	int n = 0, largest = 0, sum = 0;
+	for (int k = 0; k < kMaxInfluences && total > 0; k++) {
+		if (!(weights[k] > 0))
+			continue;
+		int q = static_cast<int>(weights[k] / total * kWeightScale + 0.5f);
+		if (q == 0)
+			continue;
+		qweights[n] = static_cast<uint16_t>(q);
+		qbones[n] = static_cast<uint16_t>(bone_ids[k]);
+		if (q > qweights[largest])
+			largest = n;
+		sum += q;
+		n++;
+	}
+	if (n > 0)
+		qweights[largest] = static_cast<uint16_t>(qweights[largest] + kWeightScale - sum);
+	return n;
+}
+
+static int BucketOf(int influences) {
+	int b = 0;
+	while (kBucketInfluences[b] < influences)
+		b++;
+	return b;
+}
+
+void BuildSkinningMesh(int vertices, float const* positions, float const* normals,
+	float const* weights, float const* bone_ids, SkinningMesh& mesh) {
+	std::vector<uint16_t> qweights(vertices * kMaxInfluences), qbones(vertices * kMaxInfluences);
+	std::vector<int> counts(vertices);
+	int sizes[kSkinningBuckets] = {};
+	for (int v = 0; v < vertices; v++) {
+		counts[v] = QuantizeWeights(weights + v * kMaxInfluences, bone_ids + v * kMaxInfluences,
+			&qweights[v * kMaxInfluences], &qbones[v * kMaxInfluences]);
+		sizes[BucketOf(counts[v])]++;
+	}
+	mesh.vertices = vertices;
+	for (int b = 0; b < kSkinningBuckets; b++) {
+		auto& bucket = mesh.buckets[b];
+		int padded = (sizes[b] + 3) & ~3;
+		bucket.influences = kBucketInfluences[b];
+		bucket.count = 0;
+		bucket.vertices.assign(padded, -1);
+		bucket.px.assign(padded, 0);
+		bucket.py.assign(padded, 0);
+		bucket.pz.assign(padded, 0);
+		bucket.nx.assign(padded, 0);
+		bucket.ny.assign(padded, 0);
+		bucket.nz.assign(padded, 0);
+		bucket.weights.assign(padded * bucket.influences, 0);
+		bucket.bones.assign(padded * bucket.influences, 0);
+		bucket.bone_ranges.clear();
+	}
+	for (int v = 0; v < vertices; v++) {
+		auto& bucket = mesh.buckets[BucketOf(counts[v])];
+		int slot = bucket.count++;
+		bucket.vertices[slot] = v;
+		bucket.px[slot] = positions[v * 3];
+		bucket.py[slot] = positions[v * 3 + 1];
+		bucket.pz[slot] = positions[v * 3 + 2];
+		if (normals) {
+			bucket.nx[slot] = normals[v * 3];
+			bucket.ny[slot] = normals[v * 3 + 1];
+			bucket.nz[slot] = normals[v * 3 + 2];
+		}
+		for (int k = 0; k < counts[v]; k++) {
+			bucket.weights[slot * bucket.influences + k] = qweights[v * kMaxInfluences + k];
+			bucket.bones[slot * bucket.influences + k] = qbones[v * kMaxInfluences + k];
+		}
+	}
+}
+
+void BuildBoneInfluences(std::vector<int> const& parents, SkinningMesh& mesh) {
+	for (auto& bucket : mesh.buckets) {
+		// blocks of 4 slots moved by each bone, in increasing order
+		std::vector<std::vector<int>> blocks(parents.size());
+		for (int slot = 0; slot < bucket.count; slot++) {
+			for (int k = 0; k < bucket.influences; k++) {
+				if (bucket.weights[slot * bucket.influences + k] == 0)
+					continue;
+				for (int b = bucket.bones[slot * bucket.influences + k]; b >= 0; b = parents[b]) {
+					if (blocks[b].empty() || blocks[b].back() != slot / 4)
+						blocks[b].push_back(slot / 4);
+				}
+			}
+		}
+		bucket.bone_ranges.assign(parents.size(), VertexRanges());
+		for (size_t b = 0; b < parents.size(); b++) {
+			auto& ranges = bucket.bone_ranges[b];
+			for (auto block : blocks[b]) {
+				if (!ranges.empty() && ranges.back().end == block * 4) {
+					ranges.back().end += 4;
+				} else {
+					VertexRange range = { block * 4, block * 4 + 4 };
+					ranges.push_back(range);
+				}
+			}
+			if (!ranges.empty())
+				ranges.back().end = std::min(ranges.back().end, bucket.count);
+		}
+	}
+}
+
+void CollectDirtyRanges(SkinningBucket const& bucket, std::vector<bool> const& dirty, VertexRanges& ranges) {
+	VertexRanges all;
+	for (size_t b = 0; b < dirty.size() && b < bucket.bone_ranges.size(); b++) {
+		if (dirty[b])
+			all.insert(all.end(), bucket.bone_ranges[b].begin(), bucket.bone_ranges[b].end());
+	}
+	std::sort(all.begin(), all.end(), [](VertexRange const& a, VertexRange const& b) { return a.begin < b.begin; });
+	ranges.clear();
+	for (auto const& range : all) {
+		if (!ranges.empty() && range.begin <= ranges.back().end)
+			ranges.back().end = std::max(ranges.back().end, range.end);
+		else
+			ranges.push_back(range);
+	}
+}
+
+#ifdef MOBAMAS_SSE2
+
+// Blends the bone rows of one slot; each row is 4 columns of a palette entry.
+template <int Influences>
+static inline void BlendRows(SkinningBucket const& bucket, float const* palette, int slot, __m128* rows) {
+	const __m128 scale = _mm_set1_ps(1.0f / kWeightScale);
+	rows[0] = rows[1] = rows[2] = _mm_setzero_ps();
+	for (int k = 0; k < Influences; k++) {
+		auto bone = palette + bucket.bones[slot * Influences + k] * kPaletteStride;
+		__m128 weight = _mm_mul_ps(_mm_set1_ps(bucket.weights[slot * Influences + k]), scale);
+		rows[0] = _mm_add_ps(rows[0], _mm_mul_ps(_mm_loadu_ps(bone), weight));
+		rows[1] = _mm_add_ps(rows[1], _mm_mul_ps(_mm_loadu_ps(bone + 4), weight));
+		rows[2] = _mm_add_ps(rows[2], _mm_mul_ps(_mm_loadu_ps(bone + 8), weight));
+	}
+}
+
+template <int Influences>
+static void SkinSlots(SkinningBucket const& bucket, float const* palette, int begin, int end,
+	float* positions, float* normals) {
+	for (int v = begin; v < end; v += 4) {
+		// blended matrices of 4 slots, transposed so that m[r][c] holds
+		// column c of row r for each slot
+		__m128 rows[4][3], m[3][4];
+		for (int l = 0; l < 4; l++)
+			BlendRows<Influences>(bucket, palette, v + l, rows[l]);
+		for (int r = 0; r < 3; r++) {
+			m[r][0] = rows[0][r];
+			m[r][1] = rows[1][r];
+			m[r][2] = rows[2][r];
+			m[r][3] = rows[3][r];
+			_MM_TRANSPOSE4_PS(m[r][0], m[r][1], m[r][2], m[r][3]);
+		}
+
+		const __m128 px = _mm_loadu_ps(&bucket.px[v]), py = _mm_loadu_ps(&bucket.py[v]), pz = _mm_loadu_ps(&bucket.pz[v]);
+		const __m128 nx = _mm_loadu_ps(&bucket.nx[v]), ny = _mm_loadu_ps(&bucket.ny[v]), nz = _mm_loadu_ps(&bucket.nz[v]);
+		__m128 out_p[3], out_n[3];
+		for (int r = 0; r < 3; r++) {
+			out_n[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r][0], nx), _mm_mul_ps(m[r][1], ny)), _mm_mul_ps(m[r][2], nz));
+			out_p[r] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r][0], px), _mm_mul_ps(m[r][1], py)), _mm_mul_ps(m[r][2], pz)), m[r][3]);
+		}
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(out_n[0], out_n[0]), _mm_mul_ps(out_n[1], out_n[1])), _mm_mul_ps(out_n[2], out_n[2])));
+		// leave too short normals as they are
+		__m128 valid = _mm_cmpgt_ps(length, _mm_set1_ps(kMinNormalLength));
+		__m128 inv = _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1), length)),
+			_mm_andnot_ps(valid, _mm_set1_ps(1)));
+
+		float p[3][4], n[3][4];
+		for (int r = 0; r < 3; r++) {
+			_mm_storeu_ps(p[r], out_p[r]);
+			_mm_storeu_ps(n[r], _mm_mul_ps(out_n[r], inv));
+		}
+		int lanes = end - v < 4 ? end - v : 4;
+		for (int l = 0; l < lanes; l++) {
+			int vertex = bucket.vertices[v + l];
+			for (int r = 0; r < 3; r++)
+				positions[vertex * 3 + r] = p[r][l];
+			if (normals) {
+				for (int r = 0; r < 3; r++)
+					normals[vertex * 3 + r] = n[r][l];
+			}
+		}
+	}
+}
+
+#else
+
+template <int Influences>
+static void SkinSlots(SkinningBucket const& bucket, float const* palette, int begin, int end,
+	float* positions, float* normals) {
+	for (int v = begin; v < end; v++) {
+		float m[3][4] = {};
+		for (int k = 0; k < Influences; k++) {
+			float w = bucket.weights[v * Influences + k] * (1.0f / kWeightScale);
+			auto bone = palette + bucket.bones[v * Influences + k] * kPaletteStride;
+			for (int i = 0; i < kPaletteStride; i++)
+				m[i / 4][i % 4] += bone[i] * w;
+		}
+		int vertex = bucket.vertices[v];
+		float n[3];
+		for (int r = 0; r < 3; r++) {
+			positions[vertex * 3 + r] = m[r][0] * bucket.px[v] + m[r][1] * bucket.py[v] + m[r][2] * bucket.pz[v] + m[r][3];
+			n[r] = m[r][0] * bucket.nx[v] + m[r][1] * bucket.ny[v] + m[r][2] * bucket.nz[v];
+		}
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= kMinNormalLength)
+			length = 1;
+		if (normals) {
+			for (int r = 0; r < 3; r++)
+				normals[vertex * 3 + r] = n[r] / length;
+		}
+	}
+}
+
+#endif
+
+void SkinVertices(SkinningBucket const& bucket, float const* palette, int begin, int end,
+	float* positions, float* normals) {
+	switch (bucket.influences) {
+	case 1:
+		SkinSlots<1>(bucket, palette, begin, end, positions, normals);
+		break;
+	case 2:
+		SkinSlots<2>(bucket, palette, begin, end, positions, normals);
+		break;
+	default:
+		SkinSlots<kMaxInfluences>(bucket, palette, begin, end, positions, normals);
+		break;
+	}
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace mobamas {
+
+// Linear blend skinning on the CPU for MeshGroup::applyBoneMotion.
+
+const int kMaxInfluences = 4; // bone assignments per vertex, as Polycode::Mesh
+const int kPaletteStride = 12; // floats per bone in the palette
+const int kWeightScale = 65535; // quantized weights of a vertex sum up to this
+
+// Vertices are bucketed by the number of bones they are weighted by, so that
+// kernels for 1 and 2 influences skip the empty assignments.
+const int kSkinningBuckets = 3;
+const int kBucketInfluences[kSkinningBuckets] = { 1, 2, kMaxInfluences };
+
+// Slots [begin, end) of a bucket; begin is a multiple of 4.
+struct VertexRange {
+	int begin, end;
+};
+typedef std::vector<VertexRange> VertexRanges;
+
+// Rest pose of the vertices of a mesh with the same number of influences, in
+// structure-of-arrays form so that 4 vertices are loaded at once. Slots keep the
+// order of the mesh and are padded to a multiple of 4 with zero weights.
+struct SkinningBucket {
+	int influences;
+	int count;
+	std::vector<int32_t> vertices; // index in the mesh of each slot
+	std::vector<float> px, py, pz;
+	std::vector<float> nx, ny, nz;
+	std::vector<uint16_t> weights; // influences per slot, out of kWeightScale
+	std::vector<uint16_t> bones; // influences per slot
+	// Per bone, sorted ranges of the slots that move with it, that is weighted
+	// by the bone or by one of its descendants.
+	std::vector<VertexRanges> bone_ranges;
+
+	int PaddedCount() const { return static_cast<int>(px.size()); }
+};
+
+struct SkinningMesh {
+	int vertices;
+	SkinningBucket buckets[kSkinningBuckets];
+};
+
+// positions and normals are xyz per vertex (normals may be null), weights and
+// bone_ids kMaxInfluences per vertex, as the vertex arrays of Polycode::Mesh.
+void BuildSkinningMesh(int vertices, float const* positions, float const* normals,
+	float const* weights, float const* bone_ids, SkinningMesh& mesh);
+
+// parents[i] is the index of the parent bone of bone i, or -1 for roots.
+void BuildBoneInfluences(std::vector<int> const& parents, SkinningMesh& mesh);
+
+// Merged ranges of the slots moved by the bones where dirty is true.
+void CollectDirtyRanges(SkinningBucket const& bucket, std::vector<bool> const& dirty, VertexRanges& ranges);
+
+// The palette holds the upper 3 rows of each bone matrix, 3x4 row major, so that
+// row r dotted with (x, y, z, 1) gives the r-th coordinate of the skinned point.
+
+// Writes skinned positions and normalized normals of slots [begin, end) to their
+// vertices, xyz per vertex; normals may be null. begin must be a multiple of 4.
+// Uses SSE2 where available.
+void SkinVertices(SkinningBucket const& bucket, float const* palette, int begin, int end,
+	float* positions, float* normals);
+
+}
@@ -0,0 +1,219 @@
+#include "TriangleBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mobamas {
+
+const int kMaxBvhDepth = 64;
+
+static double Coord(Polycode::Vector3 const& v, int axis) {
+	return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+TriangleBvh::TriangleBvh(std::vector<Polycode::Vector3> const& positions, std::vector<unsigned int> const& indices) {
+	int count = indices.size() / 3;
+	std::vector<Polycode::Vector3> centroids(count);
+	std::vector<unsigned int> order(count);
+	for (int t = 0; t < count; t++) {
+		centroids[t] = (positions[indices[t * 3]] + positions[indices[t * 3 + 1]] + positions[indices[t * 3 + 2]]) / 3;
+		order[t] = t;
+	}
+	if (count > 0)
+		Build(centroids, order, 0, count);
+	triangles_ = order;
+	corners_.resize(count * 3);
+	for (int i = 0; i < count; i++) {
+		for (int c = 0; c < 3; c++)
+			corners_[i * 3 + c] = indices[order[i] * 3 + c];
+	}
+}
+
+// Split on the longest axis of the centroids near the median, at a multiple of
+// kPacketTriangles so that every leaf is one packet; shallow enough for kMaxBvhDepth.
+int TriangleBvh::Build(std::vector<Polycode::Vector3> const& centroids, std::vector<unsigned int>& order, int begin, int end) {
+	int index = nodes_.size();
+	Node node = { 0, begin, end - begin };
+	nodes_.push_back(node);
+	if (end - begin <= kPacketTriangles)
+		return index;
+	double min[3], max[3];
+	for (int a = 0; a < 3; a++) {
+		min[a] = std::numeric_limits<double>::infinity();
+		max[a] = -min[a];
+	}
+	for (int i = begin; i < end; i++) {
+		for (int a = 0; a < 3; a++) {
+			double c = Coord(centroids[order[i]], a);
+			min[a] = std::min(min[a], c);
+			max[a] = std::max(max[a], c);
+		}
+	}
+	int axis = 0;
+	for (int a = 1; a < 3; a++) {
+		if (max[a] - min[a] > max[axis] - min[axis])
+			axis = a;
+	}
+	int mid = begin + ((end - begin) / 2 + kPacketTriangles - 1) / kPacketTriangles * kPacketTriangles;
+	std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+		[&](unsigned int a, unsigned int b) { return Coord(centroids[a], axis) < Coord(centroids[b], axis); });
+	Build(centroids, order, begin, mid);
+	int second = Build(centroids, order, mid, end);
+	nodes_[index].second = second;
+	nodes_[index].count = 0;
+	return index;
+}
+
+// Nearest float not inside (or not beyond) x, so that boxes never shrink.
+static float RoundDown(double x) {
+	float f = static_cast<float>(x);
+	return f > x ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+}
+
+static float RoundUp(double x) {
+	float f = static_cast<float>(x);
+	return f < x ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+}
+
+void TriangleBvh::Refit(std::vector<Polycode::Vector3> const& positions, std::vector<BvhBox>& boxes,
+	std::vector<float>& packets) const
+{
+	boxes.resize(nodes_.size());
+	packets.resize((triangles_.size() + kPacketTriangles - 1) / kPacketTriangles * kPacketFloats);
+	// children follow their parents
+	for (int i = nodes_.size() - 1; i >= 0; i--) {
+		auto const& node = nodes_[i];
+		auto& box = boxes[i];
+		if (node.count == 0) {
+			auto const& a = boxes[i + 1];
+			auto const& b = boxes[node.second];
+			for (int axis = 0; axis < 3; axis++) {
+				box.min[axis] = std::min(a.min[axis], b.min[axis]);
+				box.max[axis] = std::max(a.max[axis], b.max[axis]);
+			}
+			continue;
+		}
+		double min[3], max[3];
+		for (int axis = 0; axis < 3; axis++) {
+			min[axis] = std::numeric_limits<double>::infinity();
+			max[axis] = -min[axis];
+		}
+		for (int c = node.first * 3, end = (node.first + node.count) * 3; c < end; c++) {
+			auto const& p = positions[corners_[c]];
+			for (int axis = 0; axis < 3; axis++) {
+				double v = Coord(p, axis);
+				min[axis] = std::min(min[axis], v);
+				max[axis] = std::max(max[axis], v);
+			}
+		}
+		for (int axis = 0; axis < 3; axis++) {
+			box.min[axis] = RoundDown(min[axis]);
+			box.max[axis] = RoundUp(max[axis]);
+		}
+		PackTriangles(positions, &corners_[node.first * 3], node.count,
+			&packets[node.first / kPacketTriangles * kPacketFloats]);
+	}
+}
+
+// Distance along the unit direction where the ray enters box, if before limit.
+static bool EnterBox(BvhBox const& box, double const* origin, double const* direction, double limit, double& enter) {
+	double near = 0, far = limit;
+	for (int a = 0; a < 3; a++) {
+		if (direction[a] == 0) {
+			if (origin[a] < box.min[a] || origin[a] > box.max[a])
+				return false;
+			continue;
+		}
+		double t0 = (box.min[a] - origin[a]) / direction[a];
+		double t1 = (box.max[a] - origin[a]) / direction[a];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		near = std::max(near, t0);
+		far = std::min(far, t1);
+		if (near > far)
+			return false;
+	}
+	enter = near;
+	return true;
+}
+
+static Intersection Hit(const Polycode::Ray& ray, double const* direction, float distance, unsigned int triangle) {
+	Intersection res;
+	res.found = true;
+	res.scene_mesh = nullptr;
+	res.first_vertex_index = triangle * 3;
+	res.point = ray.origin + Polycode::Vector3(direction[0], direction[1], direction[2]) * distance;
+	return res;
+}
+
+Intersection TriangleBvh::Raycast(const Polycode::Ray& ray, std::vector<BvhBox> const& boxes,
+	std::vector<float> const& packets) const
+{
+	Intersection best;
+	best.found = false;
+	double length = ray.direction.length();
+	if (nodes_.empty() || length == 0)
+		return best;
+	double origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+	double direction[3] = { ray.direction.x / length, ray.direction.y / length, ray.direction.z / length };
+	float origin_f[3] = { float(origin[0]), float(origin[1]), float(origin[2]) };
+	float direction_f[3] = { float(direction[0]), float(direction[1]), float(direction[2]) };
+	float distance = std::numeric_limits<float>::infinity(); // to the nearest hit so far
+	int nearest = -1;
+
+	struct Entry {
+		int node;
+		double enter;
+	} stack[kMaxBvhDepth + 1];
+	int top = 0;
+	double enter;
+	if (!EnterBox(boxes[0], origin, direction, distance, enter))
+		return best;
+	Entry root = { 0, enter };
+	stack[top++] = root;
+	while (top > 0) {
+		auto entry = stack[--top];
+		if (entry.enter > distance)
+			continue;
+		auto const& node = nodes_[entry.node];
+		if (node.count > 0) {
+			int packet = node.first / kPacketTriangles;
+			int lane = IntersectPackets(origin_f, direction_f, &packets[packet * kPacketFloats], 1, distance);
+			if (lane >= 0)
+				nearest = node.first + lane;
+			continue;
+		}
+		// visit the nearer child first, so that the farther is often pruned
+		Entry children[2];
+		int hits = 0;
+		int ids[2] = { entry.node + 1, node.second };
+		for (int c = 0; c < 2; c++) {
+			if (EnterBox(boxes[ids[c]], origin, direction, distance, enter)) {
+				Entry child = { ids[c], enter };
+				children[hits++] = child;
+			}
+		}
+		if (hits == 2 && children[0].enter < children[1].enter)
+			std::swap(children[0], children[1]);
+		for (int c = 0; c < hits; c++)
+			stack[top++] = children[c];
+	}
+	return nearest < 0 ? best : Hit(ray, direction, distance, triangles_[nearest]);
+}
+
+Intersection TriangleBvh::RaycastAll(const Polycode::Ray& ray, std::vector<float> const& packets) const {
+	Intersection best;
+	best.found = false;
+	double length = ray.direction.length();
+	if (length == 0)
+		return best;
+	double direction[3] = { ray.direction.x / length, ray.direction.y / length, ray.direction.z / length };
+	float origin_f[3] = { float(ray.origin.x), float(ray.origin.y), float(ray.origin.z) };
+	float direction_f[3] = { float(direction[0]), float(direction[1]), float(direction[2]) };
+	float distance = std::numeric_limits<float>::infinity();
+	int nearest = IntersectPackets(origin_f, direction_f, packets.data(), packets.size() / kPacketFloats, distance);
+	return nearest < 0 ? best : Hit(ray, direction, distance, triangles_[nearest]);
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <Polycode.h>
+
+#include "Intersection.h"
+#include "TrianglePackets.h"
+
+namespace mobamas {
+
+// Bounding box of a node of TriangleBvh, rounded outward to float.
+struct BvhBox {
+	float min[3], max[3];
+};
+
+// Bounding volume hierarchy over the triangles of a mesh. The tree is built once
+// from one pose; since skinning moves neighboring triangles together, later poses
+// only refit the boxes of the same tree, bottom up in linear time.
+class TriangleBvh {
+public:
+	// indices as Mesh::indexArray, 3 per triangle, into positions.
+	TriangleBvh(std::vector<Polycode::Vector3> const& positions, std::vector<unsigned int> const& indices);
+	int nodeCount() const { return static_cast<int>(nodes_.size()); }
+
+	// Boxes of every node and the triangles packed in leaf order (see
+	// TrianglePackets.h) for positions, a pose of the vertices built on.
+	void Refit(std::vector<Polycode::Vector3> const& positions, std::vector<BvhBox>& boxes,
+		std::vector<float>& packets) const;
+	// The nearest hit as FindIntersectionPolygon with boxes and packets of a Refit.
+	// scene_mesh is left to the caller.
+	Intersection Raycast(const Polycode::Ray& ray, std::vector<BvhBox> const& boxes,
+		std::vector<float> const& packets) const;
+	// As Raycast testing every packet, without the boxes.
+	Intersection RaycastAll(const Polycode::Ray& ray, std::vector<float> const& packets) const;
+
+private:
+	struct Node {
+		int second; // interior nodes: index of the second child, the first follows the node
+		// leaves: triangles [first, first + count) of corners_, first a multiple of
+		// kPacketTriangles; 0 count for interior nodes
+		int first, count;
+	};
+	int Build(std::vector<Polycode::Vector3> const& centroids, std::vector<unsigned int>& order, int begin, int end);
+
+	std::vector<Node> nodes_; // depth first, so children after their parents
+	std::vector<unsigned int> triangles_; // in leaf order, index of the triangle in the mesh
+	std::vector<unsigned int> corners_; // in leaf order, vertex indices, 3 per triangle
+};
+
+}
@@ -0,0 +1,117 @@
+#include "TrianglePackets.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MOBAMAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace mobamas {
+
+const float kMinDeterminant = 0.000001f; // as kEpsilon of CalculateIntersectionPoint
+
+void PackTriangles(std::vector<Polycode::Vector3> const& positions, unsigned int const* corners, int count, float* packet) {
+	for (int lane = 0; lane < kPacketTriangles; lane++) {
+		if (lane >= count) {
+			for (int i = 0; i < 9; i++)
+				packet[i * kPacketTriangles + lane] = 0;
+			continue;
+		}
+		auto const& v0 = positions[corners[lane * 3]];
+		auto e1 = positions[corners[lane * 3 + 1]] - v0, e2 = positions[corners[lane * 3 + 2]] - v0;
+		float values[9] = {
+			static_cast<float>(v0.x), static_cast<float>(v0.y), static_cast<float>(v0.z),
+			static_cast<float>(e1.x), static_cast<float>(e1.y), static_cast<float>(e1.z),
+			static_cast<float>(e2.x), static_cast<float>(e2.y), static_cast<float>(e2.z) };
+		for (int i = 0; i < 9; i++)
+			packet[i * kPacketTriangles + lane] = values[i];
+	}
+}
+
+#ifdef MOBAMAS_SSE2
+
+int IntersectPackets(float const* origin, float const* direction, float const* packets, int packet_count, float& distance) {
+	const __m128 ox = _mm_set1_ps(origin[0]), oy = _mm_set1_ps(origin[1]), oz = _mm_set1_ps(origin[2]);
+	const __m128 dx = _mm_set1_ps(direction[0]), dy = _mm_set1_ps(direction[1]), dz = _mm_set1_ps(direction[2]);
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+	const __m128 min_det = _mm_set1_ps(kMinDeterminant);
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	int best = -1;
+	for (int p = 0; p < packet_count; p++) {
+		auto packet = packets + p * kPacketFloats;
+		const __m128 v0x = _mm_loadu_ps(packet), v0y = _mm_loadu_ps(packet + 4), v0z = _mm_loadu_ps(packet + 8);
+		const __m128 e1x = _mm_loadu_ps(packet + 12), e1y = _mm_loadu_ps(packet + 16), e1z = _mm_loadu_ps(packet + 20);
+		const __m128 e2x = _mm_loadu_ps(packet + 24), e2y = _mm_loadu_ps(packet + 28), e2z = _mm_loadu_ps(packet + 32);
+		// p = d x e2, det = e1 . p
+		__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+		__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+		__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+		__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+		__m128 hit = _mm_cmpge_ps(_mm_and_ps(det, abs_mask), min_det);
+		if (_mm_movemask_ps(hit) == 0)
+			continue;
+		__m128 inv = _mm_div_ps(one, det);
+		// s = o - v0, u = s . p / det
+		__m128 sx = _mm_sub_ps(ox, v0x), sy = _mm_sub_ps(oy, v0y), sz = _mm_sub_ps(oz, v0z);
+		__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv);
+		// q = s x e1, v = d . q / det, t = e2 . q / det
+		__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+		__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+		__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+		__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv);
+		__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv);
+		hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+		hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+		hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmplt_ps(t, _mm_set1_ps(distance))));
+		int mask = _mm_movemask_ps(hit);
+		if (mask == 0)
+			continue;
+		float ts[4];
+		_mm_storeu_ps(ts, t);
+		for (int lane = 0; lane < kPacketTriangles; lane++) {
+			if ((mask & (1 << lane)) && ts[lane] < distance) {
+				distance = ts[lane];
+				best = p * kPacketTriangles + lane;
+			}
+		}
+	}
+	return best;
+}
+
+#else
+
+int IntersectPackets(float const* origin, float const* direction, float const* packets, int packet_count, float& distance) {
+	auto const* d = direction;
+	int best = -1;
+	for (int p = 0; p < packet_count; p++) {
+		auto packet = packets + p * kPacketFloats;
+		for (int lane = 0; lane < kPacketTriangles; lane++) {
+			float v0[3], e1[3], e2[3];
+			for (int a = 0; a < 3; a++) {
+				v0[a] = packet[a * kPacketTriangles + lane];
+				e1[a] = packet[(3 + a) * kPacketTriangles + lane];
+				e2[a] = packet[(6 + a) * kPacketTriangles + lane];
+			}
+			float pv[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+			float det = e1[0] * pv[0] + e1[1] * pv[1] + e1[2] * pv[2];
+			if (std::fabs(det) < kMinDeterminant)
+				continue;
+			float inv = 1 / det;
+			float s[3] = { origin[0] - v0[0], origin[1] - v0[1], origin[2] - v0[2] };
+			float u = (s[0] * pv[0] + s[1] * pv[1] + s[2] * pv[2]) * inv;
+			float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+			float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv;
+			float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+			if (u < 0 || v < 0 || u + v > 1 || t < 0 || t >= distance)
+				continue;
+			distance = t;
+			best = p * kPacketTriangles + lane;
+		}
+	}
+	return best;
+}
+
+#endif
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+#include <Polycode.h>
+
+namespace mobamas {
+
+// Ray against triangles 4 at a time by Moller-Trumbore, for picking.
+
+const int kPacketTriangles = 4;
+// A packet is structure of arrays of v0, e1 = v1 - v0 and e2 = v2 - v0:
+// v0x[4], v0y[4], v0z[4], e1x[4], ..., e2z[4].
+const int kPacketFloats = 9 * kPacketTriangles;
+
+// Packs count (at most kPacketTriangles) triangles given by 3 indices into
+// positions each. Lanes past count are degenerate and never hit.
+void PackTriangles(std::vector<Polycode::Vector3> const& positions, unsigned int const* corners, int count, float* packet);
+
+// The triangle of packets hit nearest to origin before distance along the unit
+// direction, as packet * kPacketTriangles + lane, or -1. distance is updated.
+// Hits as CalculateIntersectionPoint: edges included, nearly parallel rejected.
+int IntersectPackets(float const* origin, float const* direction, float const* packets, int packet_count, float& distance);
+
+}
@@ -1,66 +1,10 @@
 #include "Util.h"
 
 #include <iostream>
-#include "DepthMap.h"
 #include "EditorApp.h"
 
 namespace mobamas {
 
-	std::vector<Polycode::Vector3> ActualVertexPositions(Polycode::SceneMesh *mesh) {
-		std::vector<Polycode::Vector3> result;
-		auto raw = mesh->getMesh();
-		result.reserve(raw->getVertexCount());
-		auto mesh_transform = mesh->getConcatenatedMatrix();
-		Polycode::Skeleton *skeleton;
-		if ((skeleton = mesh->getSkeleton())) {
-			for (int vidx = 0; vidx < raw->vertexPositionArray.data.size() / 3; vidx++) {
-				auto rest_vert = Polycode::Vector3(raw->vertexPositionArray.data[vidx * 3],
-					raw->vertexPositionArray.data[vidx * 3 + 1],
-					raw->vertexPositionArray.data[vidx * 3 + 2]);
-				Polycode::Vector3 real_pos;
-				for (int b = 0; b < 4; b++)
-				{
-					auto bidx = vidx * 4 + b;
-					auto weight = raw->vertexBoneWeightArray.data[bidx];
-					if (weight > 0.0) {
-						auto bone = skeleton->getBone(raw->vertexBoneIndexArray.data[bidx]);
-						real_pos += bone->finalMatrix * rest_vert * weight;
-					}
-				}
-				result.push_back(mesh_transform * real_pos);
-			}
-		}
-		else {
-			for (int vidx = 0; vidx < raw->vertexPositionArray.data.size() / 3; vidx++) {
-				result.push_back(mesh_transform * Polycode::Vector3(
-					raw->vertexPositionArray.data[vidx * 3],
-					raw->vertexPositionArray.data[vidx * 3 + 1],
-					raw->vertexPositionArray.data[vidx * 3 + 2]));
-			}
-		}
-		return result;
-	}
-
-	void DisplayPinchMats(DepthMap const& depth_map, Option<cv::Point3f> const& pinch_point) {
-#ifdef _DEBUG
-		IplImage *writeTo = cvCreateImage(cvSize(depth_map.w, depth_map.h), IPL_DEPTH_8U, 3);
-		auto roi = cv::Rect(depth_map.offset, depth_map.offset + cv::Point(depth_map.w, depth_map.h));
-		IplImage background = depth_map.normalized(roi);
-		cvMerge(&background, &background ,&background, NULL, writeTo);
-		auto binary = depth_map.binary(roi);
-		for (size_t i = 0; i < binary.total(); i++) {
-			writeTo->imageData[i * 3 + 2] = binary.at<uchar>(i) > 0 ? 0xff : 0;
-		}
-		if (pinch_point) {
-			cv::Point img_pt((*pinch_point).x * depth_map.w, (*pinch_point).y * depth_map.h);
-			cvCircle(writeTo, img_pt, 3, CV_RGB(255, 0, 60), -1);
-		}
-		cvShowImage("result", writeTo);
-		cvWaitKey(1);
-		cvReleaseImage(&writeTo);
-#endif
-	}
-
 	void ReportPxcBadStatus(const pxcStatus& status) {
 		switch (status) {
 		case PXC_STATUS_NO_ERROR:
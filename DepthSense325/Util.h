@@ -5,10 +5,6 @@
 
 namespace mobamas {
 
-struct DepthMap;
-
-std::vector<Polycode::Vector3> ActualVertexPositions(Polycode::SceneMesh *mesh);
-void DisplayPinchMats(DepthMap const& depth_map, Option<cv::Point3f> const& pinch_point);
 void ReportPxcBadStatus(const pxcStatus& status);
 Polycode::Vector2 CameraPointToScreen(Number x, Number y);
 
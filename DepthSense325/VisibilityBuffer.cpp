@@ -0,0 +1,197 @@
+#include "VisibilityBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Import.h"
+
+namespace mobamas {
+
+// Redraw everything when the moved triangles cover more than this of the canvas
+const double kMaxPartialRedrawRatio = 0.25;
+const float kMinDepth = 0.001f; // vertices nearer to the camera plane are not drawn
+
+VisibilityBuffer::VisibilityBuffer(int width, int height, float scale) :
+	scale_(scale),
+	ids_(height, width, CV_32SC1, cv::Scalar(kNoTriangle)),
+	depths_(height, width, CV_32FC1, cv::Scalar(0)) {
+}
+
+void VisibilityBuffer::Project(WorldVertices const& world, std::vector<ScreenVertex>& screen) const {
+	auto renderer = Polycode::CoreServices::getInstance()->getRenderer();
+	// the camera looks along its -z axis from its position
+	auto const& m = camera_.m;
+	Polycode::Vector3 eye(m[3][0], m[3][1], m[3][2]), forward(-m[2][0], -m[2][1], -m[2][2]);
+	forward.Normalize();
+	screen.resize(world.positions.size());
+	for (size_t v = 0; v < screen.size(); v++) {
+		auto const& p = world.positions[v];
+		auto on_screen = renderer->Project(camera_, projection_, view_, p);
+		float depth = static_cast<float>((p - eye).dot(forward));
+		screen[v].x = static_cast<float>(on_screen.x * scale_);
+		screen[v].y = static_cast<float>(on_screen.y * scale_);
+		screen[v].inv_depth = depth > kMinDepth ? 1 / depth : 0;
+	}
+}
+
+cv::Rect VisibilityBuffer::Bounds(MeshEntry const& entry, int triangle, std::vector<ScreenVertex> const& screen) const {
+	float left = 0, top = 0, right = 0, bottom = 0;
+	for (int i = 0; i < 3; i++) {
+		auto const& v = screen[entry.indices[triangle * 3 + i]];
+		if (i == 0 || v.x < left)
+			left = v.x;
+		if (i == 0 || v.x > right)
+			right = v.x;
+		if (i == 0 || v.y < top)
+			top = v.y;
+		if (i == 0 || v.y > bottom)
+			bottom = v.y;
+	}
+	int x = static_cast<int>(std::floor(left)), y = static_cast<int>(std::floor(top));
+	cv::Rect bounds(x, y, static_cast<int>(std::ceil(right)) - x + 1, static_cast<int>(std::ceil(bottom)) - y + 1);
+	return bounds & cv::Rect(0, 0, ids_.cols, ids_.rows);
+}
+
+void VisibilityBuffer::Update(MeshGroup* group, Polycode::Matrix4 const& camera, Polycode::Matrix4 const& projection,
+	Polycode::Rectangle const& view)
+{
+	bool full = std::memcmp(camera_.ml, camera.ml, sizeof(camera.ml)) != 0
+		|| std::memcmp(projection_.ml, projection.ml, sizeof(projection.ml)) != 0
+		|| view_.x != view.x || view_.y != view.y || view_.w != view.w || view_.h != view.h;
+	camera_ = camera;
+	projection_ = projection;
+	view_ = view;
+
+	auto meshes = group->getSceneMeshes();
+	if (meshes_.size() != meshes.size()) {
+		full = true;
+		meshes_.clear();
+		int first_id = 0;
+		for (auto mesh : meshes) {
+			MeshEntry entry;
+			entry.mesh = mesh;
+			entry.first_id = first_id;
+			entry.version = 0;
+			auto const& indices = mesh->getMesh()->indexArray.data;
+			entry.indices.assign(indices.begin(), indices.end());
+			first_id += entry.indices.size() / 3;
+			meshes_.push_back(entry);
+		}
+	}
+
+	cv::Rect dirty;
+	std::vector<ScreenVertex> screen;
+	std::vector<bool> moved;
+	for (auto& entry : meshes_) {
+		auto world = group->worldVertices(entry.mesh);
+		if (!world || (!full && world->version == entry.version))
+			continue;
+		Project(*world, screen);
+		entry.version = world->version;
+		if (!full && entry.screen.size() == screen.size()) {
+			// the areas of the moved triangles before and after
+			moved.assign(screen.size(), false);
+			for (size_t v = 0; v < screen.size(); v++) {
+				moved[v] = std::memcmp(&screen[v], &entry.screen[v], sizeof(ScreenVertex)) != 0;
+			}
+			for (int t = 0, n = entry.indices.size() / 3; t < n; t++) {
+				if (!moved[entry.indices[t * 3]] && !moved[entry.indices[t * 3 + 1]] && !moved[entry.indices[t * 3 + 2]])
+					continue;
+				for (auto const* s : { &entry.screen, &screen }) {
+					auto bounds = Bounds(entry, t, *s);
+					if (bounds.area() > 0)
+						dirty = dirty.area() > 0 ? dirty | bounds : bounds;
+				}
+			}
+		} else {
+			full = true;
+		}
+		entry.screen.swap(screen);
+	}
+	if (full || dirty.area() > kMaxPartialRedrawRatio * ids_.total()) {
+		Redraw(cv::Rect(0, 0, ids_.cols, ids_.rows));
+	} else if (dirty.area() > 0) {
+		Redraw(dirty);
+	}
+}
+
+void VisibilityBuffer::Redraw(cv::Rect const& area) {
+	ids_(area) = cv::Scalar(kNoTriangle);
+	depths_(area) = cv::Scalar(0);
+	for (auto const& entry : meshes_) {
+		if (entry.screen.empty())
+			continue;
+		for (int t = 0, n = entry.indices.size() / 3; t < n; t++) {
+			ScreenVertex const* v[3] = {
+				&entry.screen[entry.indices[t * 3]],
+				&entry.screen[entry.indices[t * 3 + 1]],
+				&entry.screen[entry.indices[t * 3 + 2]] };
+			if (v[0]->inv_depth == 0 || v[1]->inv_depth == 0 || v[2]->inv_depth == 0)
+				continue;
+			auto bounds = Bounds(entry, t, entry.screen) & area;
+			if (bounds.area() > 0)
+				Rasterize(v, entry.first_id + t, bounds);
+		}
+	}
+}
+
+// Pixels whose centers are inside the triangle, both windings, nearest wins.
+// Inverse depth is linear on the screen, so it is interpolated as is.
+void VisibilityBuffer::Rasterize(ScreenVertex const* v[3], int id, cv::Rect const& area) {
+	float doubled_area = (v[1]->x - v[0]->x) * (v[2]->y - v[0]->y) - (v[2]->x - v[0]->x) * (v[1]->y - v[0]->y);
+	if (doubled_area == 0)
+		return;
+	float inv_area = 1 / doubled_area;
+	// barycentric weight of vertex i is edge function of the opposite edge
+	float dx[3], dy[3], c[3];
+	for (int i = 0; i < 3; i++) {
+		auto a = v[(i + 1) % 3], b = v[(i + 2) % 3];
+		dx[i] = -(b->y - a->y) * inv_area;
+		dy[i] = (b->x - a->x) * inv_area;
+		c[i] = ((b->y - a->y) * a->x - (b->x - a->x) * a->y) * inv_area;
+	}
+	for (int y = area.y; y < area.y + area.height; y++) {
+		float py = y + 0.5f;
+		int* id_row = ids_.ptr<int>(y);
+		float* depth_row = depths_.ptr<float>(y);
+		for (int x = area.x; x < area.x + area.width; x++) {
+			float px = x + 0.5f;
+			float w0 = dx[0] * px + dy[0] * py + c[0];
+			float w1 = dx[1] * px + dy[1] * py + c[1];
+			float w2 = dx[2] * px + dy[2] * py + c[2];
+			if (w0 < 0 || w1 < 0 || w2 < 0)
+				continue;
+			float inv_depth = w0 * v[0]->inv_depth + w1 * v[1]->inv_depth + w2 * v[2]->inv_depth;
+			if (inv_depth > depth_row[x]) {
+				depth_row[x] = inv_depth;
+				id_row[x] = id;
+			}
+		}
+	}
+}
+
+VisibilityBuffer::MeshEntry const& VisibilityBuffer::Entry(int id) const {
+	size_t i = 0;
+	while (i + 1 < meshes_.size() && meshes_[i + 1].first_id <= id)
+		i++;
+	return meshes_[i];
+}
+
+Polycode::SceneMesh* VisibilityBuffer::mesh(int id) const {
+	return Entry(id).mesh;
+}
+
+int VisibilityBuffer::firstVertexIndex(int id) const {
+	return (id - Entry(id).first_id) * 3;
+}
+
+void VisibilityBuffer::corners(int id, cv::Point2f out[3]) const {
+	auto const& entry = Entry(id);
+	for (int i = 0; i < 3; i++) {
+		auto const& v = entry.screen[entry.indices[(id - entry.first_id) * 3 + i]];
+		out[i] = cv::Point2f(v.x, v.y);
+	}
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <Polycode.h>
+
+namespace mobamas {
+
+class MeshGroup;
+struct WorldVertices;
+
+// The front-most triangle and its depth at every pixel of the paint canvas,
+// rasterized on the CPU from the world vertices of a MeshGroup. Used from the
+// paint worker only.
+class VisibilityBuffer {
+public:
+	// width and height of the canvas, scale from the screen to the canvas.
+	VisibilityBuffer(int width, int height, float scale);
+
+	// Bring the buffer up to date with the last world vertices of group, seen
+	// through the matrices and viewport of Renderer::Project. Nothing is drawn if
+	// neither has changed, and only the screen area of the triangles that moved
+	// if it is small, as when a few bones are rotated.
+	void Update(MeshGroup* group, Polycode::Matrix4 const& camera, Polycode::Matrix4 const& projection,
+		Polycode::Rectangle const& view);
+
+	// Triangle ids per pixel (CV_32SC1), kNoTriangle for the background.
+	cv::Mat const& ids() const { return ids_; }
+	static const int kNoTriangle = -1;
+	Polycode::SceneMesh* mesh(int id) const;
+	// As Intersection::first_vertex_index.
+	int firstVertexIndex(int id) const;
+	// Corners of the triangle on the canvas as of the last Update.
+	void corners(int id, cv::Point2f out[3]) const;
+
+private:
+	struct ScreenVertex {
+		float x, y; // on the canvas
+		float inv_depth; // 1 / distance from the camera plane, 0 if behind the camera
+	};
+	struct MeshEntry {
+		Polycode::SceneMesh* mesh;
+		int first_id; // ids of the triangles of the mesh follow this
+		unsigned int version; // of the world vertices drawn, 0 for none
+		std::vector<unsigned int> indices; // 3 per triangle
+		std::vector<ScreenVertex> screen;
+	};
+	void Project(WorldVertices const& world, std::vector<ScreenVertex>& screen) const;
+	void Redraw(cv::Rect const& area);
+	void Rasterize(ScreenVertex const* v[3], int id, cv::Rect const& area);
+	cv::Rect Bounds(MeshEntry const& entry, int triangle, std::vector<ScreenVertex> const& screen) const;
+	MeshEntry const& Entry(int id) const;
+
+	float scale_;
+	cv::Mat ids_; // CV_32SC1
+	cv::Mat depths_; // CV_32FC1, inverse depth, 0 for the background
+	std::vector<MeshEntry> meshes_;
+	Polycode::Matrix4 camera_, projection_;
+	Polycode::Rectangle view_;
+};
+
+}
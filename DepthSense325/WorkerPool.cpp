@@ -0,0 +1,75 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace mobamas {
+
+WorkerPool::WorkerPool(int workers) : body_(nullptr), count_(0), next_(0), running_(0), generation_(0), quit_(false) {
+	for (int i = 0; i < workers; i++)
+		workers_.push_back(std::thread(&WorkerPool::WorkerLoop, this));
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_);
+		quit_ = true;
+	}
+	wake_.notify_all();
+	for (auto& w : workers_)
+		w.join();
+}
+
+void WorkerPool::TakeTasks(std::function<void(int)> const& body, int n) {
+	for (int i = next_++; i < n; i = next_++)
+		body(i);
+}
+
+void WorkerPool::WorkerLoop() {
+	unsigned seen = 0;
+	while (true) {
+		std::function<void(int)> const* body;
+		int n;
+		{
+			std::unique_lock<std::mutex> lock(m_);
+			wake_.wait(lock, [&]() { return quit_ || generation_ != seen; });
+			if (quit_)
+				return;
+			seen = generation_;
+			body = body_;
+			n = count_;
+		}
+		TakeTasks(*body, n);
+		std::lock_guard<std::mutex> lock(m_);
+		if (--running_ == 0)
+			done_.notify_one();
+	}
+}
+
+void WorkerPool::ParallelFor(int n, std::function<void(int)> const& body) {
+	if (workers_.empty() || n <= 1) {
+		for (int i = 0; i < n; i++)
+			body(i);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_);
+		body_ = &body;
+		count_ = n;
+		next_ = 0;
+		running_ = workers();
+		generation_++;
+	}
+	wake_.notify_all();
+	TakeTasks(body, n);
+	// every worker has to see this job before the next one may start
+	std::unique_lock<std::mutex> lock(m_);
+	done_.wait(lock, [&]() { return running_ == 0; });
+}
+
+WorkerPool& MainWorkerPool() {
+	// VS2013 has no thread-safe statics; only the main thread gets here
+	static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	return pool;
+}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mobamas {
+
+// Persistent threads for splitting per-frame work into tasks. The calling thread
+// takes tasks as well, so a pool of n workers runs n + 1 tasks at once.
+class WorkerPool {
+public:
+	explicit WorkerPool(int workers);
+	~WorkerPool();
+	int workers() const { return static_cast<int>(workers_.size()); }
+	// Runs body(i) for each i in [0, n) and returns when all are done.
+	// Not reentrant: call from one thread at a time.
+	void ParallelFor(int n, std::function<void(int)> const& body);
+
+private:
+	std::vector<std::thread> workers_;
+	std::mutex m_;
+	std::condition_variable wake_, done_;
+	std::function<void(int)> const* body_;
+	int count_;
+	std::atomic<int> next_;
+	int running_; // workers not yet done with the current job
+	unsigned generation_;
+	bool quit_;
+
+	void WorkerLoop();
+	void TakeTasks(std::function<void(int)> const& body, int n);
+};
+
+// Pool of hardware_concurrency() - 1 workers shared by the main thread.
+WorkerPool& MainWorkerPool();
+
+}
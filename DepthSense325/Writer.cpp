@@ -4,14 +4,27 @@
 #include <cstdio>
 #include <chrono>
 #include <codecvt>
+#include <iostream>
 #include <locale>
 
+#include "DepthMap.h"
+#include "DepthMapUtil.h"
 #include "Recorder.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
 namespace mobamas {
 
+// Frames waiting for the corpus thread beyond this are dropped, not to pile up
+// while gzip is slower than the camera.
+const size_t kMaxQueuedCorpusFrames = 64;
+
+struct Writer::CorpusFrame {
+	DepthMap depth_map;
+	Option<cv::Point3f> pinch_point;
+	DepthSource source;
+};
+
 static std::wstring strftime(std::wstring const& format) {
 	wchar_t buffer[1024];
 	auto now = std::chrono::system_clock::now();
@@ -64,9 +77,18 @@ Writer::Writer(Models const& model, OperationMode const& mode) : recorder_(nullp
 	assert(_wmkdir(dirname_.c_str()) == 0 && "Failed to create writer directory");
 	log_.open(dirname_ + L"/log.txt", std::ios::out);
 	assert(log_.is_open() && "Failed to open log file");
+	if (!journal_.Open(dirname_ + L"/pinch_events.journal", model, mode))
+		std::cerr << "Failed to open pinch journal" << std::endl;
 }
 
 Writer::~Writer() {
+	{
+		std::lock_guard<std::mutex> lock(m_corpus_);
+		corpus_quit_ = true;
+	}
+	corpus_ready_.notify_one();
+	if (corpus_thread_.joinable())
+		corpus_thread_.join();
 	log_.close();
 }
 
@@ -131,6 +153,52 @@ void Writer::WritePose(Polycode::Skeleton* skeleton) {
 	w.close();
 }
 
+void Writer::WritePinchSample(DepthMap const& depth_map, Option<cv::Point3f> const& pinch_point, DepthSource const& source) {
+	std::unique_ptr<CorpusFrame> frame(new CorpusFrame);
+	frame->depth_map = depth_map;
+	frame->depth_map.raw_mat = depth_map.raw_mat.clone();
+	frame->depth_map.normalized = depth_map.normalized.clone();
+	frame->depth_map.binary = depth_map.binary.clone();
+	frame->pinch_point = pinch_point;
+	frame->source.operation_mode = source.operation_mode;
+	frame->source.depth = source.depth.clone();
+	frame->source.mask = source.mask.clone();
+	{
+		std::lock_guard<std::mutex> lock(m_corpus_);
+		if (corpus_queue_.size() >= kMaxQueuedCorpusFrames) {
+			std::cerr << "Pinch corpus is behind; dropped " << ++corpus_dropped_ << " frames" << std::endl;
+			return;
+		}
+		corpus_queue_.push_back(std::move(frame));
+		if (!corpus_thread_.joinable())
+			corpus_thread_ = std::thread(&Writer::CorpusLoop, this);
+	}
+	corpus_ready_.notify_one();
+}
+
+// Writes the queued frames in order until the Writer is destroyed and the queue is empty.
+void Writer::CorpusLoop() {
+	std::string dir_multi;
+	wstrToUtf8(dir_multi, dirname_ + L"/corpus");
+	_wmkdir((dirname_ + L"/corpus").c_str());
+	while (true) {
+		std::unique_ptr<CorpusFrame> frame;
+		{
+			std::unique_lock<std::mutex> lock(m_corpus_);
+			corpus_ready_.wait(lock, [&]() { return corpus_quit_ || !corpus_queue_.empty(); });
+			if (corpus_queue_.empty())
+				return;
+			frame = std::move(corpus_queue_.front());
+			corpus_queue_.pop_front();
+		}
+		char name[32];
+		sprintf(name, "frame_%06d.yml.gz", corpus_count_++);
+		if (!mobamas::WritePinchSample(dir_multi, name, frame->depth_map, frame->pinch_point, frame->source)) {
+			std::cerr << "Failed to write pinch sample " << name << std::endl;
+		}
+	}
+}
+
 std::wostream& Writer::log() {
 	log_ << strftime(L"%Y-%m-%d %H:%M:%S") << L"  ";
 	return log_;
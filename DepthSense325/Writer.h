@@ -1,12 +1,21 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <Polycode.h>
 
 #include "Context.h"
+#include "Option.h"
+#include "PinchJournal.h"
 
 namespace mobamas {
 
+struct DepthMap;
+struct DepthSource;
 class Recorder;
 
 class Writer {
@@ -15,13 +24,29 @@ public:
 	~Writer();
 	void WriteTexture(Polycode::Texture* texture);
 	void WritePose(Polycode::Skeleton* skeleton);
+	// Append a frame to the pinch corpus in this recording directory. Thread safe.
+	// Frames are written in the order of the calls on one corpus thread, from
+	// copies of the Mats taken here.
+	void WritePinchSample(DepthMap const& depth_map, Option<cv::Point3f> const& pinch_point, DepthSource const& source);
 	std::wostream& log();
+	PinchJournalWriter& journal() { return journal_; }
 	Recorder& recorder() { return *recorder_; }
 
 private:
 	std::wstring dirname_;
 	std::wofstream log_;
 	std::unique_ptr<Recorder> recorder_;
+	PinchJournalWriter journal_;
+	struct CorpusFrame;
+	void CorpusLoop();
+
+	std::mutex m_corpus_;
+	std::condition_variable corpus_ready_;
+	std::deque<std::unique_ptr<CorpusFrame>> corpus_queue_;
+	std::thread corpus_thread_; // started by the first frame
+	bool corpus_quit_ = false;
+	int corpus_count_ = 0; // used from corpus_thread_ only
+	int corpus_dropped_ = 0;
 };
 
 }
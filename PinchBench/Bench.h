@@ -0,0 +1,42 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "Context.h"
+#include "DepthMap.h"
+#include "DepthMapUtil.h"
+#include "Option.h"
+
+namespace mobamas {
+
+struct Frame {
+	std::string path;
+	DepthMap depth_map;
+	Option<cv::Point3f> truth = Option<cv::Point3f>::None();
+	DepthSource source; // empty depth if not recorded
+};
+
+struct Options {
+	std::string corpus_dir;
+	int repeat = 1;
+	double tolerance = 15.0; // px in camera resolution
+	std::string forest_path; // for PinchDecisionForest, default path if empty
+	bool replay = false;
+	OperationMode mode = FrontMode;
+	bool sweep = false;
+	int threads = 0; // 0 for all cores
+};
+
+const double kCorpusFrameInterval = 1.0 / 30; // for corpora recorded without timestamps
+
+double PixelDistance(DepthMap const& map, cv::Point3f const& a, cv::Point3f const& b);
+double FrameTime(std::vector<Frame> const& frames, size_t i);
+
+// Parameter sweep of the preprocessing, detectors and PinchTracker, printing the
+// Pareto front of latency and accuracy as JSON.
+void PrintSweep(std::ostream& os, std::vector<Frame> const& frames, Options const& options);
+
+}
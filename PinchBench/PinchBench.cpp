@@ -0,0 +1,417 @@
+// Replay benchmark of pinch detection algorithms over a labelled corpus
+// recorded by RSClient (press R while running MidAir/Front mode).
+// Depends only on OpenCV, so it runs headless on any platform, e.g.
+//   g++ -O2 -std=c++11 -pthread -DMOBAMAS_HEADLESS -I../DepthSense325 PinchBench.cpp Sweep.cpp
+//       ../DepthSense325/PinchRightEdge.cpp ../DepthSense325/PinchCenterOfHole.cpp
+//       ../DepthSense325/PinchDistanceTransform.cpp ../DepthSense325/PinchPyramid.cpp
+//       ../DepthSense325/PinchRightEdgeTracking.cpp ../DepthSense325/PinchDecisionForest.cpp
+//       ../DepthSense325/PinchForest.cpp
+//       ../DepthSense325/DepthMapUtil.cpp ../DepthSense325/PinchFilter.cpp
+//       ../DepthSense325/PinchTracker.cpp `pkg-config --cflags --libs opencv`
+// Results are written to stdout as JSON.
+// With --replay, frames are also replayed in order through PinchTracker with each
+// PinchFilter, and positions are compared to the labels at the expected display time.
+// Latency of pinch start and end after the labels is reported for each debounce.
+// With --sweep, detection parameters are searched instead (see Sweep.cpp).
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "Algorithms.h"
+#include "Bench.h"
+#include "CameraEventListeners.h"
+#include "Context.h"
+#include "DepthMap.h"
+#include "DepthMapUtil.h"
+#include "PinchFilter.h"
+#include "PinchTracker.h"
+
+namespace mobamas {
+
+struct Detector {
+	const char* name;
+	Option<cv::Point3f> (*detect)(std::shared_ptr<Context> context, const DepthMap& data);
+};
+
+const Detector kDetectors[] = {
+	{ "PinchRightEdge", PinchRightEdge },
+	{ "PinchCenterOfHole", PinchCenterOfHole },
+	{ "PinchDistanceTransform", PinchDistanceTransform },
+	{ "PinchRightEdgePyramid2", PinchRightEdgePyramid<2> },
+	{ "PinchRightEdgePyramid4", PinchRightEdgePyramid<4> },
+	{ "PinchRightEdgeTracking", PinchRightEdgeTracking },
+	{ "PinchDecisionForest", PinchDecisionForest },
+};
+
+struct Report {
+	std::vector<double> latencies; // ms
+	int tp = 0, fp = 0, fn = 0, tn = 0;
+	double error_sum = 0; // px, only for true positives
+};
+
+static double Percentile(std::vector<double> const& sorted, double p) {
+	if (sorted.empty())
+		return 0;
+	size_t idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+	return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+double PixelDistance(DepthMap const& map, cv::Point3f const& a, cv::Point3f const& b) {
+	double dx = (a.x - b.x) * map.w, dy = (a.y - b.y) * map.h;
+	return sqrt(dx * dx + dy * dy);
+}
+
+static void Score(Report& report, Frame const& frame, Option<cv::Point3f> const& found, double tolerance) {
+	if (found && frame.truth) {
+		auto error = PixelDistance(frame.depth_map, *found, *frame.truth);
+		if (error <= tolerance) {
+			report.tp++;
+			report.error_sum += error;
+		} else {
+			report.fp++;
+			report.fn++;
+		}
+	} else if (found) {
+		report.fp++;
+	} else if (frame.truth) {
+		report.fn++;
+	} else {
+		report.tn++;
+	}
+}
+
+static Report RunDetector(Detector const& detector, std::vector<Frame> const& frames, Options const& options,
+		std::shared_ptr<const PinchForest> const& forest, std::vector<Option<cv::Point3f>>* detections) {
+	Report report;
+	report.latencies.reserve(frames.size() * options.repeat);
+	for (int r = 0; r < options.repeat; r++) {
+		// tracking detectors start over on each repeat
+		auto context = std::make_shared<Context>();
+		context->hole_track = std::make_shared<HoleTrack>();
+		context->pinch_forest = forest;
+		for (auto const& frame : frames) {
+			// detectors may overwrite the binary image (cvFindContours)
+			DepthMap input = frame.depth_map;
+			input.binary = frame.depth_map.binary.clone();
+
+			int64 start = cv::getTickCount();
+			auto found = detector.detect(context, input);
+			int64 end = cv::getTickCount();
+			report.latencies.push_back((end - start) * 1000.0 / cv::getTickFrequency());
+			if (r == 0) {
+				Score(report, frame, found, options.tolerance);
+				if (detections)
+					detections->push_back(found);
+			}
+		}
+	}
+	return report;
+}
+
+static void PrintReport(std::ostream& os, Detector const& detector, Report report) {
+	std::sort(report.latencies.begin(), report.latencies.end());
+	double total = 0;
+	for (auto l : report.latencies)
+		total += l;
+	auto ratio = [](int num, int den) { return den > 0 ? num / static_cast<double>(den) : 0.0; };
+	os << "    {\"name\": \"" << detector.name << "\""
+		<< ", \"latency_ms\": {\"mean\": " << (report.latencies.empty() ? 0 : total / report.latencies.size())
+		<< ", \"p50\": " << Percentile(report.latencies, 0.5)
+		<< ", \"p99\": " << Percentile(report.latencies, 0.99)
+		<< ", \"max\": " << (report.latencies.empty() ? 0 : report.latencies.back()) << "}"
+		<< ", \"throughput_fps\": " << (total > 0 ? report.latencies.size() * 1000.0 / total : 0)
+		<< ", \"precision\": " << ratio(report.tp, report.tp + report.fp)
+		<< ", \"recall\": " << ratio(report.tp, report.tp + report.fn)
+		<< ", \"mean_error_px\": " << (report.tp > 0 ? report.error_sum / report.tp : 0)
+		<< ", \"tp\": " << report.tp << ", \"fp\": " << report.fp
+		<< ", \"fn\": " << report.fn << ", \"tn\": " << report.tn << "}";
+}
+
+struct Filter {
+	const char* name;
+	PinchFilterType type;
+};
+
+const Filter kFilters[] = {
+	{ "None", NoPinchFilter },
+	{ "MovingAverage", MovingAveragePinchFilter },
+	{ "OneEuro", OneEuroPinchFilter },
+	{ "Kalman", KalmanPinchFilter },
+};
+
+const int kMaxLagFrames = 10;
+
+double FrameTime(std::vector<Frame> const& frames, size_t i) {
+	return frames[i].depth_map.timestamp > 0 ? frames[i].depth_map.timestamp : i * kCorpusFrameInterval;
+}
+
+// Collects the events given to the listener in each frame.
+class ReplayListener : public PinchEventListener {
+public:
+	Option<cv::Point3f> moved = Option<cv::Point3f>::None();
+	bool started = false;
+	bool ended = false;
+	void Clear() { moved.Clear(); started = ended = false; }
+	void OnPinchStart(cv::Point3f point) override { started = true; }
+	void OnPinchMove(cv::Point3f point) override { moved.Reset(point); }
+	void OnPinchEnd() override { ended = true; }
+};
+
+struct TrackerConfig {
+	const char* name;
+	PinchTrackerParams params;
+};
+
+static std::vector<TrackerConfig> TrackerConfigs() {
+	TrackerConfig window = { "Window", PinchTrackerParamsFor(kDefaultTrackerWindow) };
+	window.params.confident_start_frames = window.params.start_frames; // no confident start
+	TrackerConfig confident = { "Confident", PinchTrackerParamsFor(kDefaultTrackerWindow) };
+	std::vector<TrackerConfig> configs;
+	configs.push_back(window);
+	configs.push_back(confident);
+	return configs;
+}
+
+struct TrackerReport {
+	std::vector<double> start_latencies; // ms from the first labelled frame of a pinch
+	std::vector<double> end_latencies; // ms from the first unlabelled frame after a pinch
+	int missed_starts = 0;
+	int false_starts = 0;
+};
+
+static TrackerReport RunTracker(TrackerConfig const& config, std::vector<Frame> const& frames, std::vector<Option<cv::Point3f>> const& detections, Options const& options) {
+	auto context = std::make_shared<Context>();
+	context->operation_mode = options.mode;
+	auto listener = std::make_shared<ReplayListener>();
+	context->pinch_listeners = listener;
+	PinchTracker tracker(context, config.params);
+
+	TrackerReport report;
+	double onset = -1, offset = -1; // time of the label change waiting for the tracker
+	for (size_t i = 0; i < frames.size(); i++) {
+		double time = FrameTime(frames, i);
+		listener->Clear();
+		tracker.NotifyNewData(detections[i], time);
+		bool label = frames[i].truth;
+		bool prev_label = i > 0 && frames[i - 1].truth;
+		if (label && !prev_label) {
+			onset = time;
+			offset = -1;
+		} else if (!label && prev_label) {
+			if (onset >= 0)
+				report.missed_starts++;
+			onset = -1;
+			offset = time;
+		}
+		if (listener->started) {
+			if (onset >= 0)
+				report.start_latencies.push_back((time - onset) * 1000);
+			else if (!label)
+				report.false_starts++;
+			onset = -1;
+		}
+		if (listener->ended && offset >= 0) {
+			report.end_latencies.push_back((time - offset) * 1000);
+			offset = -1;
+		}
+	}
+	if (onset >= 0)
+		report.missed_starts++;
+	return report;
+}
+
+static void PrintLatencies(std::ostream& os, std::vector<double> latencies) {
+	std::sort(latencies.begin(), latencies.end());
+	double total = 0;
+	for (auto l : latencies)
+		total += l;
+	os << "{\"mean\": " << (latencies.empty() ? 0 : total / latencies.size())
+		<< ", \"p50\": " << Percentile(latencies, 0.5)
+		<< ", \"max\": " << (latencies.empty() ? 0 : latencies.back()) << "}";
+}
+
+// Label at the given time, linearly interpolated between the adjacent labelled frames.
+static Option<cv::Point3f> TruthAt(std::vector<Frame> const& frames, double time) {
+	for (size_t i = 0; i + 1 < frames.size(); i++) {
+		double t0 = FrameTime(frames, i), t1 = FrameTime(frames, i + 1);
+		if (time < t0 || time > t1)
+			continue;
+		if (!frames[i].truth || !frames[i + 1].truth || t1 <= t0)
+			break;
+		float a = static_cast<float>((time - t0) / (t1 - t0));
+		return Option<cv::Point3f>(*frames[i].truth * (1 - a) + *frames[i + 1].truth * a);
+	}
+	return Option<cv::Point3f>::None();
+}
+
+static void PrintReplay(std::ostream& os, std::vector<Frame> const& frames, std::vector<Option<cv::Point3f>> const& detections, Options const& options) {
+	auto params = PinchFilterParamsFor(options.mode);
+	double interval = frames.size() > 1
+		? (FrameTime(frames, frames.size() - 1) - FrameTime(frames, 0)) / (frames.size() - 1)
+		: kCorpusFrameInterval;
+	os << "], \"replay\": {\"detector\": \"" << kDetectors[0].name << "\""
+		<< ", \"lead_time_ms\": " << params.lead_time * 1000
+		<< ", \"filters\": [" << std::endl;
+	for (size_t f = 0; f < sizeof(kFilters) / sizeof(kFilters[0]); f++) {
+		auto context = std::make_shared<Context>();
+		context->operation_mode = options.mode;
+		auto listener = std::make_shared<ReplayListener>();
+		context->pinch_listeners = listener;
+		PinchTracker tracker(context);
+		params.type = kFilters[f].type;
+		tracker.set_filter(CreatePinchFilter(params));
+
+		std::vector<Option<cv::Point3f>> outputs;
+		for (size_t i = 0; i < frames.size(); i++) {
+			listener->Clear();
+			tracker.NotifyNewData(detections[i], FrameTime(frames, i));
+			outputs.push_back(listener->moved);
+		}
+
+		// error to the hand position when the frame is displayed
+		double error_sum = 0;
+		int count = 0;
+		for (size_t i = 0; i < frames.size(); i++) {
+			if (!outputs[i])
+				continue;
+			auto truth = TruthAt(frames, FrameTime(frames, i) + params.lead_time);
+			if (!truth)
+				continue;
+			error_sum += PixelDistance(frames[i].depth_map, *outputs[i], *truth);
+			count++;
+		}
+		// shift of the labels which fits the outputs best; positive if outputs lag behind
+		int best_lag = 0;
+		double best_error = -1;
+		for (int lag = -kMaxLagFrames; lag <= kMaxLagFrames; lag++) {
+			double sum = 0;
+			int n = 0;
+			for (size_t i = 0; i < frames.size(); i++) {
+				int j = static_cast<int>(i) - lag;
+				if (!outputs[i] || j < 0 || j >= static_cast<int>(frames.size()) || !frames[j].truth)
+					continue;
+				sum += PixelDistance(frames[i].depth_map, *outputs[i], *frames[j].truth);
+				n++;
+			}
+			if (n > 0 && (best_error < 0 || sum / n < best_error)) {
+				best_error = sum / n;
+				best_lag = lag;
+			}
+		}
+		os << "    {\"name\": \"" << kFilters[f].name << "\""
+			<< ", \"moves\": " << count
+			<< ", \"display_error_px\": " << (count > 0 ? error_sum / count : 0)
+			<< ", \"lag_ms\": " << best_lag * interval * 1000 << "}"
+			<< (f + 1 < sizeof(kFilters) / sizeof(kFilters[0]) ? "," : "") << std::endl;
+	}
+	os << "], \"trackers\": [" << std::endl;
+	auto configs = TrackerConfigs();
+	for (size_t t = 0; t < configs.size(); t++) {
+		auto report = RunTracker(configs[t], frames, detections, options);
+		auto const& params = configs[t].params;
+		os << "    {\"name\": \"" << configs[t].name << "\""
+			<< ", \"start_frames\": " << params.start_frames
+			<< ", \"confident_start_frames\": " << params.confident_start_frames
+			<< ", \"end_frames\": " << params.end_frames
+			<< ", \"starts\": " << report.start_latencies.size()
+			<< ", \"missed_starts\": " << report.missed_starts
+			<< ", \"false_starts\": " << report.false_starts
+			<< ", \"start_latency_ms\": ";
+		PrintLatencies(os, report.start_latencies);
+		os << ", \"end_latency_ms\": ";
+		PrintLatencies(os, report.end_latencies);
+		os << "}" << (t + 1 < configs.size() ? "," : "") << std::endl;
+	}
+	os << "]}";
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+			options.repeat = std::max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+			options.tolerance = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--sweep") == 0) {
+			options.sweep = true;
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			options.threads = std::max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--forest") == 0 && i + 1 < argc) {
+			options.forest_path = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0) {
+			options.replay = true;
+		} else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "midair") == 0)
+				options.mode = MidAirMode;
+			else if (strcmp(argv[i], "front") == 0)
+				options.mode = FrontMode;
+			else
+				return false;
+		} else if (argv[i][0] != '-' && options.corpus_dir.empty()) {
+			options.corpus_dir = argv[i];
+		} else {
+			return false;
+		}
+	}
+	return !options.corpus_dir.empty();
+}
+
+}
+
+int main(int argc, char** argv) {
+	using namespace mobamas;
+	Options options;
+	if (!ParseOptions(argc, argv, options)) {
+		std::cerr << "Usage: PinchBench corpus_dir [--repeat N] [--tolerance px] [--forest path] [--replay [--mode front|midair]] [--sweep [--threads N]]" << std::endl;
+		return 1;
+	}
+
+	// loaded once and shared by all repeats; PinchDecisionForest finds nothing without it
+	auto forest = options.forest_path.empty() ? LoadPinchDetectionForest() : LoadPinchDetectionForest(options.forest_path);
+	if (!options.forest_path.empty() && !forest)
+		return 2;
+
+	std::vector<Frame> frames;
+	for (auto const& path : ListPinchCorpus(options.corpus_dir)) {
+		Frame frame;
+		frame.path = path;
+		if (!ReadPinchSample(path, frame.depth_map, frame.truth, &frame.source)) {
+			std::cerr << "Failed to read " << path << std::endl;
+			return 2;
+		}
+		frames.push_back(frame);
+	}
+	if (frames.empty()) {
+		std::cerr << "No frames in " << options.corpus_dir << std::endl;
+		return 2;
+	}
+	if (options.sweep) {
+		PrintSweep(std::cout, frames, options);
+		return 0;
+	}
+
+	std::cout << "{\"corpus\": \"" << options.corpus_dir << "\""
+		<< ", \"frames\": " << frames.size()
+		<< ", \"repeat\": " << options.repeat
+		<< ", \"tolerance_px\": " << options.tolerance
+		<< ", \"detectors\": [" << std::endl;
+	std::vector<Option<cv::Point3f>> detections;
+	for (size_t i = 0; i < sizeof(kDetectors) / sizeof(kDetectors[0]); i++) {
+		auto report = RunDetector(kDetectors[i], frames, options, forest, i == 0 ? &detections : nullptr);
+		PrintReport(std::cout, kDetectors[i], report);
+		std::cout << (i + 1 < sizeof(kDetectors) / sizeof(kDetectors[0]) ? "," : "") << std::endl;
+	}
+	if (options.replay) {
+		PrintReplay(std::cout, frames, detections, options);
+		std::cout << "}" << std::endl;
+	} else {
+		std::cout << "]}" << std::endl;
+	}
+	return 0;
+}
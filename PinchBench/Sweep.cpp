@@ -0,0 +1,295 @@
+// Parameter sweep over a recorded corpus, to replace hand tuning at the station.
+// Every combination of the grids below is evaluated, with frames processed in
+// parallel on all cores. Preprocessing parameters are swept only when every
+// sample recorded its camera source.
+//
+// Accuracy is the F1 score of the pinching state after PinchTracker against the
+// labels. Positions are not scored because reprojection with other frontal
+// parameters moves the hand away from the labels; mean_error_px is reported
+// for reference. Latency is preprocessing and detection per frame, measured
+// while other threads run, so compare it only within a sweep.
+
+#include "Bench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "Algorithms.h"
+#include "CameraEventListeners.h"
+#include "PinchFilter.h"
+#include "PinchTracker.h"
+
+namespace mobamas {
+
+struct DetectorParams {
+	const char* name;
+	Option<cv::Point3f> (*detect)(std::shared_ptr<Context> context, const DepthMap& data, double min_hole_size);
+	double min_hole_size;
+};
+
+const DetectorParams kDetectorGrid[] = {
+	{ "PinchRightEdge", PinchRightEdge, 100 },
+	{ "PinchRightEdge", PinchRightEdge, 200 },
+	{ "PinchRightEdge", PinchRightEdge, 400 },
+	{ "PinchRightEdge", PinchRightEdge, 800 },
+	{ "PinchCenterOfHole", PinchCenterOfHole, 30 },
+	{ "PinchCenterOfHole", PinchCenterOfHole, 60 },
+	{ "PinchCenterOfHole", PinchCenterOfHole, 120 },
+	{ "PinchCenterOfHole", PinchCenterOfHole, 240 },
+};
+
+// PinchTrackerParams; combinations with more confident than plain start frames are skipped
+const int kStartFramesGrid[] = { 3, 6 };
+const int kConfidentStartFramesGrid[] = { 1, 2, 3 };
+const int kEndFramesGrid[] = { 1, 3, 5 };
+const float kMinConfidenceGrid[] = { 0.3f, 0.5f, 0.7f };
+const float kMaxCoherentMoveGrid[] = { 0.025f, 0.05f, 0.1f };
+
+// Defaults of RSClient
+const float kDefaultKX = 1.0E-2f, kDefaultKY = 1.0E-2f, kDefaultKYOffset = 0.7f;
+const uint16_t kDefaultKZFar = 1200;
+const uint16_t kDefaultMinDepthThreshold = 350;
+
+const float kKXYGrid[] = { 0.9E-2f, 1.0E-2f, 1.1E-2f };
+const float kKYOffsetGrid[] = { 0.6f, 0.7f, 0.8f };
+const uint16_t kKZFarGrid[] = { 1000, 1200, 1400 };
+const uint16_t kMinDepthThresholdGrid[] = { 300, 350, 400, 450, 500 };
+
+struct PreprocessParams {
+	float kx, ky, y_offset;
+	uint16_t z_far;
+	uint16_t min_depth_threshold;
+};
+
+struct Candidate {
+	PreprocessParams preprocess;
+	int detector; // index of kDetectorGrid
+	PinchTrackerParams tracker;
+	double latency_ms;
+	int tp, fp, fn, tn; // pinching state of each frame after the tracker
+	double error_px; // mean, against labels
+	double F1() const {
+		return tp > 0 ? 2.0 * tp / (2.0 * tp + fp + fn) : 0.0;
+	}
+};
+
+template <class T, size_t N>
+static size_t CountOf(T const (&)[N]) { return N; }
+
+static void ParallelFor(int n, int threads, std::function<void(int)> const& body) {
+	std::atomic<int> next(0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.push_back(std::thread([&]() {
+			for (int i = next++; i < n; i = next++)
+				body(i);
+		}));
+	}
+	for (auto& w : workers)
+		w.join();
+}
+
+static std::vector<PinchTrackerParams> TrackerGrid() {
+	std::vector<PinchTrackerParams> grid;
+	for (auto start : kStartFramesGrid)
+		for (auto confident_start : kConfidentStartFramesGrid)
+			for (auto end : kEndFramesGrid)
+				for (auto min_confidence : kMinConfidenceGrid)
+					for (auto max_move : kMaxCoherentMoveGrid) {
+						if (confident_start > start)
+							continue;
+						PinchTrackerParams p = { start, confident_start, end, min_confidence, max_move };
+						grid.push_back(p);
+					}
+	return grid;
+}
+
+static std::vector<PreprocessParams> PreprocessGrid(std::vector<Frame> const& frames) {
+	PreprocessParams defaults = { kDefaultKX, kDefaultKY, kDefaultKYOffset, kDefaultKZFar, kDefaultMinDepthThreshold };
+	std::vector<PreprocessParams> grid;
+	for (auto const& frame : frames) {
+		if (frame.source.depth.empty()) {
+			grid.push_back(defaults); // use recorded masks as they are
+			return grid;
+		}
+	}
+	if (frames[0].source.operation_mode == FrontMode) {
+		for (auto kx : kKXYGrid)
+			for (auto ky : kKXYGrid)
+				for (auto y_offset : kKYOffsetGrid)
+					for (auto z_far : kKZFarGrid) {
+						PreprocessParams p = { kx, ky, y_offset, z_far, kDefaultMinDepthThreshold };
+						grid.push_back(p);
+					}
+	} else {
+		for (auto threshold : kMinDepthThresholdGrid) {
+			PreprocessParams p = defaults;
+			p.min_depth_threshold = threshold;
+			grid.push_back(p);
+		}
+	}
+	return grid;
+}
+
+// Same as RSClient::Run, from the recorded camera source.
+static DepthMap Preprocess(Frame const& frame, PreprocessParams const& params) {
+	DepthMap map = frame.depth_map;
+	if (frame.source.depth.empty()) {
+		map.binary = frame.depth_map.binary.clone();
+		return map;
+	}
+	auto raw_depth = frame.source.depth.clone();
+	auto seg_mask = frame.source.mask.clone();
+	cv::Point offset;
+	bool front = frame.source.operation_mode == FrontMode;
+	if (front) {
+		ReplaceFrontalOrigin(raw_depth, seg_mask, offset, map.saturated_value,
+			params.kx, params.ky, params.y_offset, params.z_far);
+	}
+	cv::Mat new_depth;
+	raw_depth.copyTo(new_depth, seg_mask);
+	auto min_depth = GetMinimumApplicableValue(new_depth);
+	if (!front && params.min_depth_threshold < min_depth + 10)
+		seg_mask = 0;
+	map.w = frame.source.depth.cols;
+	map.h = frame.source.depth.rows;
+	map.raw_mat = raw_depth;
+	map.binary = seg_mask;
+	map.offset = offset;
+	return map;
+}
+
+class PinchStateListener : public PinchEventListener {
+public:
+	bool pinching = false;
+	Option<cv::Point3f> point = Option<cv::Point3f>::None();
+	void OnPinchStart(cv::Point3f p) override { pinching = true; point.Reset(p); }
+	void OnPinchMove(cv::Point3f p) override { point.Reset(p); }
+	void OnPinchEnd() override { pinching = false; point.Clear(); }
+};
+
+static void ScoreTracked(Candidate& c, std::vector<Frame> const& frames, std::vector<Option<cv::Point3f>> const& detections) {
+	auto context = std::make_shared<Context>();
+	context->operation_mode = MouseMode;
+	auto listener = std::make_shared<PinchStateListener>();
+	context->pinch_listeners = listener;
+	PinchTracker tracker(context, c.tracker);
+	// smoothing is tuned by --replay
+	auto no_filter = PinchFilterParamsFor(context->operation_mode);
+	no_filter.type = NoPinchFilter;
+	tracker.set_filter(CreatePinchFilter(no_filter));
+	c.tp = c.fp = c.fn = c.tn = 0;
+	double error_sum = 0;
+	for (size_t i = 0; i < frames.size(); i++) {
+		tracker.NotifyNewData(detections[i], FrameTime(frames, i));
+		bool truth = frames[i].truth;
+		if (listener->pinching && truth) {
+			c.tp++;
+			error_sum += PixelDistance(frames[i].depth_map, *listener->point, *frames[i].truth);
+		} else if (listener->pinching) {
+			c.fp++;
+		} else if (truth) {
+			c.fn++;
+		} else {
+			c.tn++;
+		}
+	}
+	c.error_px = c.tp > 0 ? error_sum / c.tp : 0;
+}
+
+// Candidates not beaten by another in both latency and accuracy, by latency.
+static std::vector<Candidate> ParetoFront(std::vector<Candidate> candidates) {
+	std::sort(candidates.begin(), candidates.end(), [](Candidate const& a, Candidate const& b) {
+		return a.latency_ms < b.latency_ms || (a.latency_ms == b.latency_ms && a.F1() > b.F1());
+	});
+	std::vector<Candidate> front;
+	for (auto const& c : candidates) {
+		if (front.empty() || c.F1() > front.back().F1())
+			front.push_back(c);
+	}
+	return front;
+}
+
+static void PrintCandidate(std::ostream& os, Candidate const& c) {
+	auto ratio = [](int num, int den) { return den > 0 ? num / static_cast<double>(den) : 0.0; };
+	auto const& d = kDetectorGrid[c.detector];
+	os << "    {\"detector\": \"" << d.name << "\""
+		<< ", \"min_hole_size\": " << d.min_hole_size
+		<< ", \"start_frames\": " << c.tracker.start_frames
+		<< ", \"confident_start_frames\": " << c.tracker.confident_start_frames
+		<< ", \"end_frames\": " << c.tracker.end_frames
+		<< ", \"min_confidence\": " << c.tracker.min_confidence
+		<< ", \"max_coherent_move\": " << c.tracker.max_coherent_move
+		<< ", \"kX\": " << c.preprocess.kx
+		<< ", \"kY\": " << c.preprocess.ky
+		<< ", \"kYOffset\": " << c.preprocess.y_offset
+		<< ", \"kZFar\": " << c.preprocess.z_far
+		<< ", \"min_depth_threshold\": " << c.preprocess.min_depth_threshold
+		<< ", \"latency_ms\": " << c.latency_ms
+		<< ", \"f1\": " << c.F1()
+		<< ", \"precision\": " << ratio(c.tp, c.tp + c.fp)
+		<< ", \"recall\": " << ratio(c.tp, c.tp + c.fn)
+		<< ", \"mean_error_px\": " << c.error_px << "}";
+}
+
+void PrintSweep(std::ostream& os, std::vector<Frame> const& frames, Options const& options) {
+	int threads = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+	auto preprocess_grid = PreprocessGrid(frames);
+	const int detector_count = static_cast<int>(CountOf(kDetectorGrid));
+	auto tracker_grid = TrackerGrid();
+	const int tracker_count = static_cast<int>(tracker_grid.size());
+	const int frame_count = static_cast<int>(frames.size());
+
+	std::vector<Candidate> candidates;
+	std::vector<std::vector<Option<cv::Point3f>>> detections(detector_count,
+		std::vector<Option<cv::Point3f>>(frame_count, Option<cv::Point3f>::None()));
+	std::vector<double> preprocess_ms(frame_count);
+	std::vector<std::vector<double>> detect_ms(detector_count, std::vector<double>(frame_count));
+	for (auto const& preprocess : preprocess_grid) {
+		// each frame is preprocessed once and shared by all detectors
+		ParallelFor(frame_count, threads, [&](int i) {
+			int64 start = cv::getTickCount();
+			auto map = Preprocess(frames[i], preprocess);
+			preprocess_ms[i] = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+			for (int d = 0; d < detector_count; d++) {
+				// detectors may overwrite the binary image (cvFindContours)
+				DepthMap input = map;
+				input.binary = map.binary.clone();
+				start = cv::getTickCount();
+				detections[d][i] = kDetectorGrid[d].detect(nullptr, input, kDetectorGrid[d].min_hole_size);
+				detect_ms[d][i] = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+			}
+		});
+
+		std::vector<Candidate> batch(detector_count * tracker_count);
+		ParallelFor(static_cast<int>(batch.size()), threads, [&](int k) {
+			auto& c = batch[k];
+			c.preprocess = preprocess;
+			c.detector = k / tracker_count;
+			c.tracker = tracker_grid[k % tracker_count];
+			double total = 0;
+			for (int i = 0; i < frame_count; i++)
+				total += preprocess_ms[i] + detect_ms[c.detector][i];
+			c.latency_ms = total / frame_count;
+			ScoreTracked(c, frames, detections[c.detector]);
+		});
+		candidates.insert(candidates.end(), batch.begin(), batch.end());
+	}
+
+	auto front = ParetoFront(candidates);
+	os << "{\"corpus\": \"" << options.corpus_dir << "\""
+		<< ", \"frames\": " << frame_count
+		<< ", \"threads\": " << threads
+		<< ", \"candidates\": " << candidates.size()
+		<< ", \"pareto\": [" << std::endl;
+	for (size_t i = 0; i < front.size(); i++) {
+		PrintCandidate(os, front[i]);
+		os << (i + 1 < front.size() ? "," : "") << std::endl;
+	}
+	os << "]}" << std::endl;
+}
+
+}
@@ -0,0 +1,310 @@
+// Offline trainer of the PinchForest used by PinchDecisionForest, from a corpus
+// recorded by RSClient (press R while running MidAir/Front mode), e.g.
+//   g++ -O2 -std=c++11 -pthread -DMOBAMAS_HEADLESS -I../DepthSense325 PinchForestTrainer.cpp
+//       ../DepthSense325/PinchForest.cpp ../DepthSense325/DepthMapUtil.cpp
+//       `pkg-config --cflags --libs opencv`
+//   ./a.out corpus_dir pinch_forest.yml.gz
+// Copy the output next to the executable of DepthSense325 to use it.
+//
+// Hand parts are labelled automatically: hand pixels near the labelled pinch point
+// are contact, pixels far from the outline are palm, and the rest are finger.
+// Each tree is trained on its own thread from a class balanced random sample.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "DepthMap.h"
+#include "DepthMapUtil.h"
+#include "Option.h"
+#include "PinchForest.h"
+
+namespace mobamas {
+
+const float kContactRadius = 8.0f; // px at 1m (about 18mm) around the labelled pinch point
+const float kPalmHalfWidth = 8.0f; // px at 1m, thicker than fingers
+const int kMaxOffset = 60; // px at 1m
+const int kMaxThreshold = 300; // mm
+const int kMinSamplesToSplit = 8;
+
+struct TrainerOptions {
+	std::string corpus_dir;
+	std::string output_path;
+	int trees = 3;
+	int depth = 12;
+	int samples = 400; // per part and frame
+	int features = 200; // offset pairs tried per node
+	int thresholds = 20; // per offset pair
+	unsigned seed = 1;
+};
+
+struct Sample {
+	int frame;
+	int x, y;
+	float scale;
+	HandPart part;
+};
+
+// Label each hand pixel with its part, or -1 for background.
+static cv::Mat LabelParts(DepthMap const& map, Option<cv::Point3f> const& truth) {
+	cv::Mat labels(map.binary.size(), CV_8SC1, cv::Scalar(-1));
+	cv::Mat to_outline;
+	cv::distanceTransform(map.binary, to_outline, CV_DIST_L2, 3);
+	// inverse of the normalization by the detectors
+	cv::Point2f pinch(-1e6f, -1e6f);
+	if (truth)
+		pinch = cv::Point2f((*truth).x * map.w + map.offset.x, (*truth).y * map.h + map.offset.y);
+	for (int y = 0; y < labels.rows; y++) {
+		for (int x = 0; x < labels.cols; x++) {
+			if (!map.binary.at<uchar>(y, x))
+				continue;
+			int depth = map.raw_mat.at<uint16_t>(y, x);
+			if (depth == 0)
+				continue;
+			float to_1m = depth / static_cast<float>(kOffsetScale);
+			float dx = x - pinch.x, dy = y - pinch.y;
+			if (sqrt(dx * dx + dy * dy) * to_1m < kContactRadius)
+				labels.at<schar>(y, x) = PinchContactPart;
+			else if (to_outline.at<float>(y, x) * to_1m > kPalmHalfWidth)
+				labels.at<schar>(y, x) = PalmPart;
+			else
+				labels.at<schar>(y, x) = FingerPart;
+		}
+	}
+	return labels;
+}
+
+static void SampleFrame(std::vector<DepthMap> const& maps, int frame, cv::Mat const& labels, int per_part, std::mt19937& rng, std::vector<Sample>& samples) {
+	std::vector<Sample> parts[kHandParts];
+	for (int y = 0; y < labels.rows; y++) {
+		for (int x = 0; x < labels.cols; x++) {
+			int part = labels.at<schar>(y, x);
+			if (part < 0)
+				continue;
+			Sample s = { frame, x, y, kOffsetScale / static_cast<float>(ProbeDepth(maps[frame], x, y)), static_cast<HandPart>(part) };
+			parts[part].push_back(s);
+		}
+	}
+	for (auto& p : parts) {
+		std::shuffle(p.begin(), p.end(), rng);
+		if (static_cast<int>(p.size()) > per_part)
+			p.resize(per_part);
+		samples.insert(samples.end(), p.begin(), p.end());
+	}
+}
+
+static double Entropy(int const* counts, int total) {
+	double e = 0;
+	for (int p = 0; p < kHandParts; p++) {
+		if (counts[p] > 0) {
+			double q = counts[p] / static_cast<double>(total);
+			e -= q * log(q);
+		}
+	}
+	return e;
+}
+
+class TreeTrainer {
+public:
+	TreeTrainer(std::vector<DepthMap> const& maps, TrainerOptions const& options, unsigned seed) :
+		maps_(maps), options_(options), rng_(seed) {}
+
+	// Fill splits and leaves of one tree, in the layout of PinchForest.
+	void Train(std::vector<Sample> samples, ForestSplit* splits, float* leaves) {
+		splits_ = splits;
+		leaves_ = leaves;
+		Grow(0, 0, samples.begin(), samples.end());
+	}
+
+private:
+	typedef std::vector<Sample>::iterator Iter;
+	std::vector<DepthMap> const& maps_;
+	TrainerOptions const& options_;
+	std::mt19937 rng_;
+	ForestSplit* splits_;
+	float* leaves_;
+	std::vector<int> features_;
+
+	int Feature(Sample const& s, ForestSplit const& split) const {
+		return SplitFeature(maps_[s.frame], s.x, s.y, s.scale, split);
+	}
+
+	void Grow(int node, int level, Iter begin, Iter end) {
+		if (level == options_.depth) {
+			SetLeaf(node - ((1 << options_.depth) - 1), begin, end);
+			return;
+		}
+		int counts[kHandParts] = {};
+		for (auto it = begin; it != end; ++it)
+			counts[it->part]++;
+		int total = static_cast<int>(end - begin);
+		ForestSplit best = { 0, 0, 0, 0, INT16_MAX }; // pass everything to the left
+		if (total >= kMinSamplesToSplit && Entropy(counts, total) > 0)
+			best = FindSplit(begin, end, counts, total);
+		splits_[node] = best;
+		auto mid = std::partition(begin, end, [&](Sample const& s) { return Feature(s, best) <= best.threshold; });
+		Grow(2 * node + 1, level + 1, begin, mid);
+		Grow(2 * node + 2, level + 1, mid, end);
+	}
+
+	ForestSplit FindSplit(Iter begin, Iter end, int const* counts, int total) {
+		std::uniform_int_distribution<int> offset(-kMaxOffset, kMaxOffset);
+		std::uniform_int_distribution<int> threshold(-kMaxThreshold, kMaxThreshold);
+		ForestSplit best = { 0, 0, 0, 0, INT16_MAX };
+		double best_gain = 0;
+		double parent = Entropy(counts, total);
+		features_.resize(total);
+		for (int f = 0; f < options_.features; f++) {
+			ForestSplit split;
+			split.ux = static_cast<int16_t>(offset(rng_));
+			split.uy = static_cast<int16_t>(offset(rng_));
+			split.vx = static_cast<int16_t>(offset(rng_));
+			split.vy = static_cast<int16_t>(offset(rng_));
+			for (int i = 0; i < total; i++)
+				features_[i] = Feature(begin[i], split);
+			for (int t = 0; t < options_.thresholds; t++) {
+				split.threshold = static_cast<int16_t>(threshold(rng_));
+				int left[kHandParts] = {};
+				int left_total = 0;
+				for (int i = 0; i < total; i++) {
+					if (features_[i] <= split.threshold) {
+						left[begin[i].part]++;
+						left_total++;
+					}
+				}
+				if (left_total == 0 || left_total == total)
+					continue;
+				int right[kHandParts];
+				for (int p = 0; p < kHandParts; p++)
+					right[p] = counts[p] - left[p];
+				double gain = parent
+					- Entropy(left, left_total) * left_total / total
+					- Entropy(right, total - left_total) * (total - left_total) / total;
+				if (gain > best_gain) {
+					best_gain = gain;
+					best = split;
+				}
+			}
+		}
+		return best;
+	}
+
+	// Part histogram with Laplace smoothing, so that empty leaves are uniform.
+	void SetLeaf(int leaf, Iter begin, Iter end) {
+		float counts[kHandParts];
+		std::fill(counts, counts + kHandParts, 1.0f);
+		for (auto it = begin; it != end; ++it)
+			counts[it->part] += 1;
+		float total = static_cast<float>(end - begin) + kHandParts;
+		for (int p = 0; p < kHandParts; p++)
+			leaves_[leaf * kHandParts + p] = counts[p] / total;
+	}
+};
+
+static bool ParseOptions(int argc, char** argv, TrainerOptions& options) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--trees") == 0 && i + 1 < argc) {
+			options.trees = std::max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+			options.depth = std::min(std::max(1, atoi(argv[++i])), 20);
+		} else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+			options.samples = std::max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--features") == 0 && i + 1 < argc) {
+			options.features = std::max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--thresholds") == 0 && i + 1 < argc) {
+			options.thresholds = std::max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			options.seed = static_cast<unsigned>(atoi(argv[++i]));
+		} else if (argv[i][0] != '-' && options.corpus_dir.empty()) {
+			options.corpus_dir = argv[i];
+		} else if (argv[i][0] != '-' && options.output_path.empty()) {
+			options.output_path = argv[i];
+		} else {
+			return false;
+		}
+	}
+	return !options.corpus_dir.empty() && !options.output_path.empty();
+}
+
+}
+
+int main(int argc, char** argv) {
+	using namespace mobamas;
+	TrainerOptions options;
+	if (!ParseOptions(argc, argv, options)) {
+		std::cerr << "Usage: PinchForestTrainer corpus_dir output.yml.gz [--trees N] [--depth N] [--samples N] [--features N] [--thresholds N] [--seed N]" << std::endl;
+		return 1;
+	}
+
+	std::vector<DepthMap> maps;
+	std::vector<cv::Mat> labels;
+	for (auto const& path : ListPinchCorpus(options.corpus_dir)) {
+		DepthMap map;
+		Option<cv::Point3f> truth = Option<cv::Point3f>::None();
+		if (!ReadPinchSample(path, map, truth)) {
+			std::cerr << "Failed to read " << path << std::endl;
+			return 2;
+		}
+		labels.push_back(LabelParts(map, truth));
+		maps.push_back(map);
+	}
+	if (maps.empty()) {
+		std::cerr << "No frames in " << options.corpus_dir << std::endl;
+		return 2;
+	}
+
+	PinchForest forest;
+	forest.trees = options.trees;
+	forest.depth = options.depth;
+	forest.splits.resize(forest.trees * forest.SplitsPerTree());
+	forest.leaves.resize(forest.trees * forest.LeavesPerTree() * kHandParts);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < forest.trees; t++) {
+		workers.push_back(std::thread([&, t]() {
+			// each tree sees its own sample of the pixels
+			std::mt19937 rng(options.seed + t);
+			std::vector<Sample> samples;
+			for (int i = 0; i < static_cast<int>(maps.size()); i++)
+				SampleFrame(maps, i, labels[i], options.samples, rng, samples);
+			TreeTrainer trainer(maps, options, rng());
+			trainer.Train(samples, &forest.splits[t * forest.SplitsPerTree()],
+				&forest.leaves[t * forest.LeavesPerTree() * kHandParts]);
+		}));
+	}
+	for (auto& w : workers)
+		w.join();
+
+	// accuracy on all labelled pixels, to compare depth and sample sizes
+	int correct[kHandParts] = {}, total[kHandParts] = {};
+	for (size_t i = 0; i < maps.size(); i++) {
+		for (int y = 0; y < labels[i].rows; y++) {
+			for (int x = 0; x < labels[i].cols; x++) {
+				int part = labels[i].at<schar>(y, x);
+				if (part < 0)
+					continue;
+				float parts[kHandParts];
+				ClassifyPixel(forest, maps[i], x, y, parts);
+				total[part]++;
+				if (std::max_element(parts, parts + kHandParts) - parts == part)
+					correct[part]++;
+			}
+		}
+	}
+	const char* names[kHandParts] = { "contact", "finger", "palm" };
+	for (int p = 0; p < kHandParts; p++) {
+		std::cerr << names[p] << ": " << correct[p] << "/" << total[p] << " pixels correct" << std::endl;
+	}
+
+	if (!SavePinchForest(options.output_path, forest)) {
+		std::cerr << "Failed to write " << options.output_path << std::endl;
+		return 3;
+	}
+	return 0;
+}